@@ -1,20 +1,82 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
-layout(location = 0) out vec3 frag_color;
+layout(location = 0) in vec2 in_position;
+layout(location = 1) in vec3 in_color;
 
-vec2 positions[3] = vec2[](
-    vec2(0.0, -0.5),
-    vec2(0.5, 0.5),
-    vec2(-0.5, 0.5)
-);
+layout(location = 0) out vec4 frag_color;
 
-vec3 colors[3] = vec3[](
-    vec3(1.0, 0.0, 0.0),
-    vec3(0.0, 1.0, 0.0),
-    vec3(0.0, 0.0, 1.0)
-);
+// SHADER_FEATURE_* bits from pipeline_registry.h, set per pipeline variant.
+layout(constant_id = 0) const uint FEATURES = 3u;
+const bool VERTEX_COLOR = (FEATURES & 1u) != 0u;
+const bool INSTANCE_COLOR = (FEATURES & 2u) != 0u;
+
+struct Instance {
+    vec2 offset;
+    float scale;
+    float rotation;
+    vec4 color;
+};
+
+struct FrameConstants {
+    float time;
+    float delta_time;
+    vec2 extent;
+};
+
+// The bindless set: storage buffers at binding 0, sampled images at 1 and samplers at 2, each
+// indexed by a slot pushed per draw. Storage buffers are viewed through whichever block
+// matches their contents.
+layout(std430, set = 0, binding = 0) readonly buffer Instances {
+    Instance instances[];
+} instance_buffers[];
+
+layout(std430, set = 0, binding = 0) readonly buffer FrameData {
+    FrameConstants frames[];
+} frame_buffers[];
+
+// Written by cull.comp; `visible` holds the indices of the instances that survived culling.
+layout(std430, set = 0, binding = 0) readonly buffer CulledDraw {
+    uint command[5];
+    uint draw_count;
+    uint visible[];
+} culled_draw_buffers[];
+
+const uint NOT_CULLED = 0xffffffffu;
+
+layout(push_constant) uniform DrawConstants {
+    uint instance_buffer;
+    // This frame's constants are frame_buffers[frame_buffer].frames[frame_constants].
+    uint frame_buffer;
+    uint frame_constants;
+    // The batch's culled draw, or NOT_CULLED to draw every instance in order.
+    uint culled_draw_buffer;
+} draw;
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    frag_color = colors[gl_VertexIndex];
+    uint instance_index = uint(gl_InstanceIndex);
+    if (draw.culled_draw_buffer != NOT_CULLED) {
+        instance_index = culled_draw_buffers[draw.culled_draw_buffer].visible[gl_InstanceIndex];
+    }
+    Instance instance = instance_buffers[draw.instance_buffer].instances[instance_index];
+    FrameConstants frame = frame_buffers[draw.frame_buffer].frames[draw.frame_constants];
+
+    // Keeps shapes undistorted on non-square targets. It only ever shrinks an axis, so the
+    // bounds cull.comp tests, which ignore it, stay conservative.
+    vec2 extent = max(frame.extent, vec2(1.0));
+    vec2 aspect = min(extent.yx / extent, vec2(1.0));
+
+    float c = cos(instance.rotation);
+    float s = sin(instance.rotation);
+    vec2 position = mat2(c, s, -s, c) * in_position * instance.scale * aspect + instance.offset;
+
+    gl_Position = vec4(position, 0.0, 1.0);
+    vec4 color = vec4(1.0);
+    if (VERTEX_COLOR) {
+        color.rgb *= in_color;
+    }
+    if (INSTANCE_COLOR) {
+        color *= instance.color;
+    }
+    frag_color = color;
 }
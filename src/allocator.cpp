@@ -0,0 +1,372 @@
+#include "allocator.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+    return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    GpuAllocator::GpuAllocator()
+        : device{VK_NULL_HANDLE}, memory_properties{}, block_size{DEFAULT_BLOCK_SIZE},
+          max_allocation_count{0}, device_allocation_count{0} {}
+
+    GpuAllocator::~GpuAllocator() {
+        this->destroy();
+    }
+
+    void GpuAllocator::init(
+        VkPhysicalDevice physical_device, VkDevice device, VkDeviceSize block_size
+    ) {
+        this->device = device;
+        this->block_size = block_size;
+        vkGetPhysicalDeviceMemoryProperties(physical_device, &this->memory_properties);
+
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(physical_device, &props);
+        this->max_allocation_count = props.limits.maxMemoryAllocationCount;
+
+        this->pools.clear();
+        this->pools.resize(this->memory_properties.memoryTypeCount * 2);
+
+        std::cout << "Successfully created GPU allocator." << std::endl;
+    }
+
+    void GpuAllocator::destroy() {
+        if (this->device == VK_NULL_HANDLE) {
+            return;
+        }
+
+        for (MemoryPool &pool : this->pools) {
+            for (std::unique_ptr<MemoryBlock> &block : pool.blocks) {
+                if (block->allocation_count > 0) {
+                    std::cout << "Warning: freeing memory block with " << block->allocation_count
+                              << " live allocations." << std::endl;
+                }
+                vkFreeMemory(this->device, block->memory, nullptr);
+            }
+            pool.blocks.clear();
+        }
+        this->device_allocation_count = 0;
+        this->device = VK_NULL_HANDLE;
+
+        std::cout << "Destroyed GPU allocator.\n";
+    }
+
+    bool GpuAllocator::allocate(
+        const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+        ResourceKind kind, Allocation &allocation
+    ) {
+        uint32_t memory_type = this->find_memory_type(requirements.memoryTypeBits, properties);
+        if (memory_type == UINT32_MAX) {
+            std::cout << "Failed to find a suitable memory type." << std::endl;
+            return false;
+        }
+
+        MemoryBlock *block = nullptr;
+        VkDeviceSize offset = 0;
+
+        if (requirements.size > this->block_size / 2) {
+            block = this->create_block(memory_type, kind, requirements.size, true);
+        } else {
+            MemoryPool &pool = this->pool(memory_type, kind);
+            for (std::unique_ptr<MemoryBlock> &candidate : pool.blocks) {
+                if (!candidate->dedicated
+                    && GpuAllocator::allocate_from_block(
+                        *candidate, requirements.size, requirements.alignment, offset
+                    )) {
+                    block = candidate.get();
+                    break;
+                }
+            }
+
+            if (!block) {
+                block = this->create_block(memory_type, kind, this->block_size, false);
+                if (block
+                    && !GpuAllocator::allocate_from_block(
+                        *block, requirements.size, requirements.alignment, offset
+                    )) {
+                    block = nullptr;
+                }
+            }
+        }
+
+        if (!block) {
+            std::cout << "Failed to allocate " << requirements.size << " bytes of GPU memory."
+                      << std::endl;
+            return false;
+        }
+
+        if (block->dedicated) {
+            block->free_ranges.clear();
+            block->used = requirements.size;
+            block->allocation_count = 1;
+        }
+
+        allocation.memory = block->memory;
+        allocation.offset = offset;
+        allocation.size = requirements.size;
+        allocation.mapped = block->mapped ? static_cast<u8 *>(block->mapped) + offset : nullptr;
+        allocation.memory_type = memory_type;
+        allocation.kind = kind;
+        allocation.block = block;
+
+        return true;
+    }
+
+    void GpuAllocator::free(Allocation &allocation) {
+        MemoryBlock *block = allocation.block;
+        if (!block) {
+            return;
+        }
+
+        block->allocation_count--;
+        block->used -= allocation.size;
+
+        if (!block->dedicated) {
+            VkDeviceSize offset = allocation.offset;
+            VkDeviceSize size = allocation.size;
+
+            std::map<VkDeviceSize, VkDeviceSize>::iterator next =
+                block->free_ranges.lower_bound(offset);
+            if (next != block->free_ranges.end() && offset + size == next->first) {
+                size += next->second;
+                next = block->free_ranges.erase(next);
+            }
+            if (next != block->free_ranges.begin()) {
+                std::map<VkDeviceSize, VkDeviceSize>::iterator prev = std::prev(next);
+                if (prev->first + prev->second == offset) {
+                    offset = prev->first;
+                    size += prev->second;
+                    block->free_ranges.erase(prev);
+                }
+            }
+            block->free_ranges[offset] = size;
+        }
+
+        // Keep one empty block per pool around so alternating alloc/free does not thrash
+        // vkAllocateMemory.
+        if (block->allocation_count == 0) {
+            MemoryPool &pool = this->pool(allocation.memory_type, allocation.kind);
+            usize empty_blocks = std::count_if(
+                pool.blocks.begin(), pool.blocks.end(),
+                [](const std::unique_ptr<MemoryBlock> &b) { return b->allocation_count == 0; }
+            );
+            if (block->dedicated || empty_blocks > 1) {
+                this->destroy_block(block);
+            }
+        }
+
+        allocation = Allocation{};
+    }
+
+    bool GpuAllocator::create_buffer(
+        const VkBufferCreateInfo &create_info, VkMemoryPropertyFlags properties, VkBuffer &buffer,
+        Allocation &allocation
+    ) {
+        VkResult res = vkCreateBuffer(this->device, &create_info, nullptr, &buffer);
+        if (res != VK_SUCCESS) {
+            std::cout << "Failed to create buffer: " << res << std::endl;
+            return false;
+        }
+
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(this->device, buffer, &requirements);
+
+        if (!this->allocate(requirements, properties, ResourceKind::Linear, allocation)) {
+            vkDestroyBuffer(this->device, buffer, nullptr);
+            buffer = VK_NULL_HANDLE;
+            return false;
+        }
+
+        vkBindBufferMemory(this->device, buffer, allocation.memory, allocation.offset);
+        return true;
+    }
+
+    void GpuAllocator::destroy_buffer(VkBuffer buffer, Allocation &allocation) {
+        vkDestroyBuffer(this->device, buffer, nullptr);
+        this->free(allocation);
+    }
+
+    bool GpuAllocator::create_image(
+        const VkImageCreateInfo &create_info, VkMemoryPropertyFlags properties, VkImage &image,
+        Allocation &allocation
+    ) {
+        VkResult res = vkCreateImage(this->device, &create_info, nullptr, &image);
+        if (res != VK_SUCCESS) {
+            std::cout << "Failed to create image: " << res << std::endl;
+            return false;
+        }
+
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(this->device, image, &requirements);
+
+        ResourceKind kind = create_info.tiling == VK_IMAGE_TILING_LINEAR ? ResourceKind::Linear
+                                                                         : ResourceKind::Optimal;
+        if (!this->allocate(requirements, properties, kind, allocation)) {
+            vkDestroyImage(this->device, image, nullptr);
+            image = VK_NULL_HANDLE;
+            return false;
+        }
+
+        vkBindImageMemory(this->device, image, allocation.memory, allocation.offset);
+        return true;
+    }
+
+    void GpuAllocator::destroy_image(VkImage image, Allocation &allocation) {
+        vkDestroyImage(this->device, image, nullptr);
+        this->free(allocation);
+    }
+
+    uint32_t
+    GpuAllocator::find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties) const {
+        for (uint32_t i = 0; i < this->memory_properties.memoryTypeCount; i++) {
+            if ((type_filter & (1 << i))
+                && (this->memory_properties.memoryTypes[i].propertyFlags & properties)
+                       == properties) {
+                return i;
+            }
+        }
+
+        return UINT32_MAX;
+    }
+
+    AllocatorStats GpuAllocator::stats() const {
+        AllocatorStats stats{};
+
+        for (const MemoryPool &pool : this->pools) {
+            for (const std::unique_ptr<MemoryBlock> &block : pool.blocks) {
+                if (block->dedicated) {
+                    stats.dedicated_count++;
+                } else {
+                    stats.block_count++;
+                }
+                stats.allocation_count += block->allocation_count;
+                stats.reserved_bytes += block->size;
+                stats.used_bytes += block->used;
+
+                for (const std::pair<const VkDeviceSize, VkDeviceSize> &range :
+                     block->free_ranges) {
+                    stats.free_bytes += range.second;
+                    stats.largest_free_range = std::max(stats.largest_free_range, range.second);
+                }
+            }
+        }
+
+        return stats;
+    }
+
+    void GpuAllocator::print_stats() const {
+        AllocatorStats stats = this->stats();
+
+        std::cout << "GPU memory: " << stats.allocation_count << " allocations in "
+                  << stats.block_count << " blocks + " << stats.dedicated_count << " dedicated, "
+                  << stats.used_bytes << "/" << stats.reserved_bytes << " bytes used, "
+                  << "fragmentation " << stats.fragmentation() * 100.0 << "%" << std::endl;
+    }
+
+    MemoryBlock *GpuAllocator::create_block(
+        u32 memory_type, ResourceKind kind, VkDeviceSize size, bool dedicated
+    ) {
+        if (this->device_allocation_count >= this->max_allocation_count) {
+            std::cout << "Reached maxMemoryAllocationCount (" << this->max_allocation_count
+                      << ")." << std::endl;
+            return nullptr;
+        }
+
+        VkMemoryAllocateInfo alloc_info{};
+        alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        alloc_info.allocationSize = size;
+        alloc_info.memoryTypeIndex = memory_type;
+
+        std::unique_ptr<MemoryBlock> block = std::make_unique<MemoryBlock>();
+        VkResult res = vkAllocateMemory(this->device, &alloc_info, nullptr, &block->memory);
+        if (res != VK_SUCCESS) {
+            std::cout << "Failed to allocate memory block: " << res << std::endl;
+            return nullptr;
+        }
+
+        block->size = size;
+        block->mapped = nullptr;
+        block->dedicated = dedicated;
+        block->allocation_count = 0;
+        block->used = 0;
+        block->free_ranges[0] = size;
+
+        if (this->memory_properties.memoryTypes[memory_type].propertyFlags
+            & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            vkMapMemory(this->device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped);
+        }
+
+        this->device_allocation_count++;
+
+        MemoryPool &pool = this->pool(memory_type, kind);
+        pool.blocks.push_back(std::move(block));
+
+        return pool.blocks.back().get();
+    }
+
+    void GpuAllocator::destroy_block(MemoryBlock *block) {
+        for (MemoryPool &pool : this->pools) {
+            std::vector<std::unique_ptr<MemoryBlock>>::iterator it = std::find_if(
+                pool.blocks.begin(), pool.blocks.end(),
+                [block](const std::unique_ptr<MemoryBlock> &b) { return b.get() == block; }
+            );
+
+            if (it != pool.blocks.end()) {
+                vkFreeMemory(this->device, block->memory, nullptr);
+                this->device_allocation_count--;
+                pool.blocks.erase(it);
+                return;
+            }
+        }
+    }
+
+    bool GpuAllocator::allocate_from_block(
+        MemoryBlock &block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset
+    ) {
+        std::map<VkDeviceSize, VkDeviceSize>::iterator best = block.free_ranges.end();
+        VkDeviceSize best_waste = UINT64_MAX;
+
+        for (std::map<VkDeviceSize, VkDeviceSize>::iterator it = block.free_ranges.begin();
+             it != block.free_ranges.end(); it++) {
+            VkDeviceSize aligned = align_up(it->first, alignment);
+            VkDeviceSize end = it->first + it->second;
+
+            if (aligned + size <= end) {
+                VkDeviceSize waste = it->second - size;
+                if (waste < best_waste) {
+                    best = it;
+                    best_waste = waste;
+                }
+            }
+        }
+
+        if (best == block.free_ranges.end()) {
+            return false;
+        }
+
+        VkDeviceSize range_offset = best->first;
+        VkDeviceSize range_end = best->first + best->second;
+        offset = align_up(range_offset, alignment);
+        block.free_ranges.erase(best);
+
+        if (offset > range_offset) {
+            block.free_ranges[range_offset] = offset - range_offset;
+        }
+        if (offset + size < range_end) {
+            block.free_ranges[offset + size] = range_end - (offset + size);
+        }
+
+        block.allocation_count++;
+        block.used += size;
+
+        return true;
+    }
+
+    GpuAllocator::MemoryPool &GpuAllocator::pool(u32 memory_type, ResourceKind kind) {
+        return this->pools[memory_type * 2 + (kind == ResourceKind::Optimal ? 1 : 0)];
+    }
+} // namespace TANELORN_ENGINE_NAMESPACE
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "defines.h"
+
+#include <vulkan/vulkan.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    // Buffers and linear images must not share a bufferImageGranularity page with optimally
+    // tiled images, so each memory type keeps one pool per kind instead of padding every range.
+    enum class ResourceKind {
+        Linear,
+        Optimal,
+    };
+
+    struct MemoryBlock {
+        VkDeviceMemory memory;
+        VkDeviceSize size;
+        void *mapped;
+        bool dedicated;
+        u32 allocation_count;
+        VkDeviceSize used;
+        // Free ranges keyed by offset, kept coalesced.
+        std::map<VkDeviceSize, VkDeviceSize> free_ranges;
+    };
+
+    struct Allocation {
+        VkDeviceMemory memory;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        // Persistently mapped pointer to the start of the allocation, or null for memory that
+        // is not host visible.
+        void *mapped;
+        u32 memory_type;
+        ResourceKind kind;
+        MemoryBlock *block;
+    };
+
+    struct AllocatorStats {
+        u32 block_count;
+        u32 dedicated_count;
+        u32 allocation_count;
+        VkDeviceSize reserved_bytes;
+        VkDeviceSize used_bytes;
+        VkDeviceSize free_bytes;
+        VkDeviceSize largest_free_range;
+
+        // 0 when all free memory is one contiguous range, approaching 1 as it gets scattered.
+        f64 fragmentation() const {
+            return this->free_bytes > 0
+                       ? 1.0 - static_cast<f64>(this->largest_free_range) / this->free_bytes
+                       : 0.0;
+        }
+    };
+
+    // Sub-allocates buffers and images from large VkDeviceMemory blocks, one set of blocks per
+    // memory type and resource kind. Ranges are placed best-fit and coalesced on free. Requests
+    // larger than half a block get their own dedicated allocation.
+    class GpuAllocator {
+    public:
+        static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+        GpuAllocator();
+        ~GpuAllocator();
+
+        GpuAllocator(const GpuAllocator &) = delete;
+        GpuAllocator &operator=(const GpuAllocator &) = delete;
+
+        void init(
+            VkPhysicalDevice physical_device, VkDevice device,
+            VkDeviceSize block_size = DEFAULT_BLOCK_SIZE
+        );
+        void destroy();
+
+        bool allocate(
+            const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+            ResourceKind kind, Allocation &allocation
+        );
+        void free(Allocation &allocation);
+
+        bool create_buffer(
+            const VkBufferCreateInfo &create_info, VkMemoryPropertyFlags properties,
+            VkBuffer &buffer, Allocation &allocation
+        );
+        void destroy_buffer(VkBuffer buffer, Allocation &allocation);
+
+        bool create_image(
+            const VkImageCreateInfo &create_info, VkMemoryPropertyFlags properties, VkImage &image,
+            Allocation &allocation
+        );
+        void destroy_image(VkImage image, Allocation &allocation);
+
+        // Returns UINT32_MAX without logging, so optional properties can be probed for.
+        uint32_t find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties) const;
+
+        AllocatorStats stats() const;
+        void print_stats() const;
+
+    private:
+        struct MemoryPool {
+            std::vector<std::unique_ptr<MemoryBlock>> blocks;
+        };
+
+        MemoryBlock *
+        create_block(u32 memory_type, ResourceKind kind, VkDeviceSize size, bool dedicated);
+        void destroy_block(MemoryBlock *block);
+        static bool allocate_from_block(
+            MemoryBlock &block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset
+        );
+        MemoryPool &pool(u32 memory_type, ResourceKind kind);
+
+        VkDevice device;
+        VkPhysicalDeviceMemoryProperties memory_properties;
+        VkDeviceSize block_size;
+        u32 max_allocation_count;
+        u32 device_allocation_count;
+        // Indexed by memory type * 2 + resource kind.
+        std::vector<MemoryPool> pools;
+    };
+} // namespace TANELORN_ENGINE_NAMESPACE
@@ -1,17 +1,94 @@
 #include "app.h"
+#include "cpu_profiler.h"
+
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <utility>
 
 namespace TANELORN_ENGINE_NAMESPACE {
-    App::App() : window{}, renderer{window} {}
+    App::App(PresentPolicy present_policy, f64 frame_limit)
+        : window{}, renderer{window, DEFAULT_FRAMES_IN_FLIGHT, present_policy} {
+        this->renderer.set_frame_limit(frame_limit);
+#ifndef TN_RELEASE
+        this->renderer.enable_shader_hot_reload();
+#endif
+    }
 
     App::~App() {}
 
     void App::run() {
+        std::chrono::steady_clock::time_point last_report = std::chrono::steady_clock::now();
+        u64 reported_upload_batches = 0;
+
         while (!this->window.close_requested()) {
+            TN_PROFILE_FRAME();
+
+            // Pace before polling so the frame is built from the most recent input.
+            this->renderer.pace_frame();
             this->window.poll_events();
             this->renderer.draw_frame();
+
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (now - last_report >= std::chrono::seconds(1)) {
+                const FrameStats &stats = this->renderer.frame_stats();
+                f64 average_ms = stats.average_frame_ms();
+
+                std::cout << "Frame time: avg " << average_ms << " ms, min " << stats.min_frame_ms
+                          << " ms, max " << stats.max_frame_ms << " ms ("
+                          << (average_ms > 0.0 ? 1000.0 / average_ms : 0.0) << " fps)"
+                          << std::endl;
+
+                const LatencyStats &latency = this->renderer.latency_stats();
+                std::cout << (this->renderer.present_wait_enabled() ? "Input to present"
+                                                                    : "Input to GPU done")
+                          << ": avg " << latency.average_ms() << " ms, max " << latency.max_ms
+                          << " ms" << std::endl;
+
+                const GpuProfiler &profiler = this->renderer.gpu_profiler();
+                for (const GpuScopeStats &scope : profiler.scope_stats()) {
+                    std::cout << "GPU " << scope.name << ": min " << scope.min_ms << " ms, avg "
+                              << scope.average_ms << " ms, p99 " << scope.p99_ms << " ms"
+                              << std::endl;
+                }
+                if (profiler.statistics_enabled()) {
+                    const GpuPipelineStats &pipeline = profiler.pipeline_stats();
+                    std::cout << "GPU main pass: " << pipeline.input_assembly_primitives
+                              << " primitives, " << pipeline.vertex_invocations
+                              << " vertex invocations, " << pipeline.fragment_invocations
+                              << " fragment invocations" << std::endl;
+                }
+
+#ifndef TN_RELEASE
+                std::cout << "CPU:";
+                for (const CpuScopeStats &scope : CpuProfiler::get().frame_stats()) {
+                    std::cout << ' ' << scope.name << ' ' << scope.total_ms << " ms;";
+                }
+                std::cout << std::endl;
+#endif
+
+                const UploadStats &uploads = this->renderer.upload_stats();
+                if (uploads.batches_completed != reported_upload_batches) {
+                    std::cout << "Uploads: " << uploads.bytes_uploaded << " bytes, "
+                              << uploads.bandwidth_mb_per_s() << " MB/s, latency avg "
+                              << uploads.average_latency_ms() << " ms, max "
+                              << uploads.max_latency_ms << " ms" << std::endl;
+                    reported_upload_batches = uploads.batches_completed;
+                }
+
+                this->renderer.reset_frame_stats();
+                last_report = now;
+            }
         }
         this->renderer.wait_idle();
+
+        if (const char *trace_path = getenv("TN_GPU_TRACE")) {
+            this->renderer.gpu_profiler().write_chrome_trace(trace_path);
+        }
+#ifndef TN_RELEASE
+        if (const char *trace_path = getenv("TN_CPU_TRACE")) {
+            CpuProfiler::get().write_chrome_trace(trace_path);
+        }
+#endif
     }
 } // namespace TANELORN_ENGINE_NAMESPACE
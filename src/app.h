@@ -6,7 +6,7 @@
 namespace TANELORN_ENGINE_NAMESPACE {
     class App {
       public:
-        App();
+        App(PresentPolicy present_policy = PresentPolicy::Mailbox, f64 frame_limit = 0.0);
         ~App();
 
         void run();
@@ -0,0 +1,448 @@
+#include "cpu_profiler.h"
+#include "renderer.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(TN_PLATFORM_WIN32)
+#include <psapi.h>
+#endif
+
+constexpr VkExtent2D bench_extent = {1280, 720};
+constexpr u32 warmup_frames = 10;
+
+struct BenchResult {
+    std::string scene;
+    u32 frames;
+    f64 startup_ms;
+    f64 frames_per_second;
+    f64 cpu_ms_per_frame;
+    f64 gpu_ms_per_frame;
+    f64 gpu_p99_ms;
+    u64 peak_rss_bytes;
+    u64 device_memory_bytes;
+    u32 graph_passes;
+    u32 graph_barriers;
+    f64 graph_compile_ms;
+    u64 frame_data_high_water_bytes;
+    u32 pipeline_variants;
+    f64 pipeline_build_ms;
+    bool async_compute;
+    u64 compute_dispatches;
+    bool gpu_culling;
+    u32 culled_objects;
+};
+
+struct Scene {
+    const char *name;
+    void (*setup)(tn::Renderer &renderer);
+    // Called before every frame, for work recorded per frame. May be null.
+    void (*frame)(tn::Renderer &renderer);
+    // Runs compute on the graphics queue (TN_ASYNC_COMPUTE=0), as a baseline for async compute.
+    bool serial_compute;
+};
+
+static std::vector<tn::InstanceData> random_instances(u32 count, f32 min_scale, f32 max_scale) {
+    std::mt19937 rng{1234};
+    std::uniform_real_distribution<f32> unit{0.0f, 1.0f};
+
+    std::vector<tn::InstanceData> instances(count);
+    for (tn::InstanceData &instance : instances) {
+        instance.offset[0] = unit(rng) * 2.0f - 1.0f;
+        instance.offset[1] = unit(rng) * 2.0f - 1.0f;
+        instance.scale = min_scale + unit(rng) * (max_scale - min_scale);
+        instance.rotation = unit(rng) * 6.2831853f;
+        instance.color[0] = unit(rng);
+        instance.color[1] = unit(rng);
+        instance.color[2] = unit(rng);
+        instance.color[3] = 1.0f;
+    }
+
+    return instances;
+}
+
+static void setup_triangle(tn::Renderer &) {}
+
+static void setup_instances(tn::Renderer &renderer) {
+    renderer.clear_instance_batches();
+    renderer.create_instance_batch(0, random_instances(100000, 0.01f, 0.03f));
+}
+
+// A 1000x1000 vertex grid covering the screen: 1M vertices and 6M indices in one draw.
+static void setup_large_vertex_buffer(tn::Renderer &renderer) {
+    constexpr u32 grid = 1000;
+
+    std::vector<tn::Vertex> vertices(grid * grid);
+    for (u32 y = 0; y < grid; y++) {
+        for (u32 x = 0; x < grid; x++) {
+            tn::Vertex &vertex = vertices[y * grid + x];
+            vertex.position[0] = x * 2.0f / (grid - 1) - 1.0f;
+            vertex.position[1] = y * 2.0f / (grid - 1) - 1.0f;
+            vertex.color[0] = static_cast<f32>(x) / grid;
+            vertex.color[1] = static_cast<f32>(y) / grid;
+            vertex.color[2] = 0.5f;
+        }
+    }
+
+    std::vector<u32> indices;
+    indices.reserve((grid - 1) * (grid - 1) * 6);
+    for (u32 y = 0; y + 1 < grid; y++) {
+        for (u32 x = 0; x + 1 < grid; x++) {
+            u32 i = y * grid + x;
+            indices.insert(indices.end(), {i, i + 1, i + grid, i + 1, i + grid + 1, i + grid});
+        }
+    }
+
+    renderer.clear_instance_batches();
+    u32 mesh = renderer.create_mesh(vertices, indices);
+    renderer.create_instance_batch(mesh, random_instances(1, 1.0f, 1.0f));
+}
+
+// Many small batches, each with its own instance buffer slot and indirect draw, to stress command
+// recording and per-draw state changes rather than raw vertex throughput.
+static void setup_many_batches(tn::Renderer &renderer) {
+    renderer.clear_instance_batches();
+    for (u32 i = 0; i < 1000; i++) {
+        renderer.create_instance_batch(0, random_instances(16, 0.01f, 0.02f));
+    }
+}
+
+// Prewarms every combination of topology, culling, blending and shader features, then spreads
+// batches across them, to measure parallel variant creation and per-draw pipeline switches.
+static void setup_pipeline_variants(tn::Renderer &renderer) {
+    std::vector<tn::PipelineDesc> descs;
+    for (VkPrimitiveTopology topology :
+         {VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VK_PRIMITIVE_TOPOLOGY_LINE_LIST}) {
+        for (VkCullModeFlags cull_mode : {VK_CULL_MODE_NONE, VK_CULL_MODE_BACK_BIT}) {
+            for (tn::BlendMode blend :
+                 {tn::BlendMode::Opaque, tn::BlendMode::Alpha, tn::BlendMode::Additive}) {
+                for (u32 features = 0; features <= tn::SHADER_FEATURES_ALL; features++) {
+                    tn::PipelineDesc desc = tn::PipelineDesc::defaults();
+                    desc.topology = topology;
+                    desc.cull_mode = cull_mode;
+                    desc.blend = blend;
+                    desc.features = features;
+                    descs.push_back(desc);
+                }
+            }
+        }
+    }
+    renderer.prewarm_pipelines(descs);
+
+    renderer.clear_instance_batches();
+    for (u32 i = 0; i < 200; i++) {
+        // Already built, so this only exercises deduplication.
+        u32 pipeline = renderer.request_pipeline(descs[i % descs.size()]);
+        renderer.create_instance_batch(0, random_instances(16, 0.01f, 0.02f), pipeline);
+    }
+}
+
+// 100k instances spread over nine times the screen, so most of them fall outside the viewport.
+static void setup_offscreen_instances(tn::Renderer &renderer) {
+    std::vector<tn::InstanceData> instances = random_instances(100000, 0.01f, 0.03f);
+    for (tn::InstanceData &instance : instances) {
+        instance.offset[0] *= 3.0f;
+        instance.offset[1] *= 3.0f;
+    }
+
+    renderer.clear_instance_batches();
+    renderer.create_instance_batch(0, instances);
+}
+
+// The same draw without GPU culling, as its baseline.
+static void setup_offscreen_instances_unculled(tn::Renderer &renderer) {
+    renderer.set_gpu_culling(false);
+    setup_offscreen_instances(renderer);
+}
+
+constexpr u32 particle_count = 1 << 20;
+constexpr u32 particle_iterations = 64;
+
+// The compute scenes' pipeline and buffer, set up once per renderer.
+static struct {
+    u32 pipeline;
+    u32 buffer;
+    u32 frame;
+} particles;
+
+// A particle dispatch every frame on top of the instances_100k draw, so compute has graphics
+// work to overlap with. Run against its serial twin to see what the async queue saves.
+static void setup_particles(tn::Renderer &renderer) {
+    setup_instances(renderer);
+    particles.pipeline = renderer.create_compute_pipeline(tn::embedded_spirv("particles.comp"));
+    particles.buffer = renderer.create_compute_buffer(sizeof(f32) * 4 * particle_count);
+    particles.frame = 0;
+}
+
+static void dispatch_particles(tn::Renderer &renderer) {
+    struct {
+        u32 particle_buffer;
+        u32 particle_count;
+        u32 iterations;
+        f32 time;
+    } constants;
+
+    constants.particle_buffer = renderer.compute_buffer_slot(particles.buffer);
+    constants.particle_count = particle_count;
+    constants.iterations = particle_iterations;
+    constants.time = particles.frame++ / 60.0f;
+    renderer.dispatch_compute(
+        particles.pipeline, (particle_count + 255) / 256, 1, 1, &constants, sizeof(constants)
+    );
+}
+
+static const Scene scenes[] = {
+    {"triangle", setup_triangle},
+    {"instances_100k", setup_instances},
+    {"large_vertex_buffer", setup_large_vertex_buffer},
+    {"many_batches", setup_many_batches},
+    {"pipeline_variants", setup_pipeline_variants},
+    {"particles_async", setup_particles, dispatch_particles},
+    {"particles_serial", setup_particles, dispatch_particles, true},
+    {"offscreen_culled", setup_offscreen_instances},
+    {"offscreen_unculled", setup_offscreen_instances_unculled},
+};
+
+static void set_env(const char *name, const char *value) {
+#if defined(TN_PLATFORM_WIN32)
+    _putenv_s(name, value ? value : "");
+#else
+    if (value) {
+        setenv(name, value, 1);
+    } else {
+        unsetenv(name);
+    }
+#endif
+}
+
+static void render_frame(const Scene &scene, tn::Renderer &renderer) {
+    if (scene.frame) {
+        scene.frame(renderer);
+    }
+    renderer.render_to_image();
+}
+
+// Peak resident set size since the last reset. On Linux the peak is reset per scene through
+// /proc/self/clear_refs; elsewhere it is the peak of the whole process so far.
+static void reset_peak_rss() {
+#if defined(TN_PLATFORM_XCB)
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+#endif
+}
+
+static u64 peak_rss_bytes() {
+#if defined(TN_PLATFORM_WIN32)
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+#elif defined(TN_PLATFORM_XCB)
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+        }
+    }
+#endif
+    return 0;
+}
+
+static f64 elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+static BenchResult run_scene(const Scene &scene, u32 frame_count) {
+    BenchResult result{};
+    result.scene = scene.name;
+    result.frames = frame_count;
+
+    reset_peak_rss();
+
+    // The queue choice is made at device creation, after which the setting is restored.
+    const char *async_compute = getenv("TN_ASYNC_COMPUTE");
+    std::string previous_async_compute = async_compute ? async_compute : "";
+    if (scene.serial_compute) {
+        set_env("TN_ASYNC_COMPUTE", "0");
+    }
+
+    // Every scene starts from an empty pipeline cache of its own, so startup always means a
+    // cold start rather than depending on which scenes ran before it.
+    const char *pipeline_cache = getenv("TN_PIPELINE_CACHE");
+    std::string previous_pipeline_cache = pipeline_cache ? pipeline_cache : "";
+    std::error_code err;
+    std::filesystem::path cache_path = std::filesystem::temp_directory_path(err)
+                                       / (std::string{"tn_bench_"} + scene.name + "_cache.bin");
+    std::filesystem::remove(cache_path, err);
+    set_env("TN_PIPELINE_CACHE", cache_path.string().c_str());
+
+    // Startup covers device and pipeline creation plus the scene's uploads landing.
+    std::chrono::steady_clock::time_point startup_begin = std::chrono::steady_clock::now();
+    tn::Renderer renderer{bench_extent};
+    set_env("TN_ASYNC_COMPUTE", async_compute ? previous_async_compute.c_str() : nullptr);
+    set_env("TN_PIPELINE_CACHE", pipeline_cache ? previous_pipeline_cache.c_str() : nullptr);
+    scene.setup(renderer);
+    render_frame(scene, renderer);
+    renderer.wait_idle();
+    result.startup_ms = elapsed_ms(startup_begin);
+
+    for (u32 i = 0; i < warmup_frames; i++) {
+        render_frame(scene, renderer);
+    }
+    renderer.wait_idle();
+
+    // CPU time excludes pacing, so a GPU-bound scene shows up as GPU time rather than as CPU
+    // time spent waiting for a free frame slot.
+    f64 cpu_ms = 0.0;
+    std::chrono::steady_clock::time_point run_begin = std::chrono::steady_clock::now();
+    for (u32 i = 0; i < frame_count; i++) {
+        TN_PROFILE_FRAME();
+        renderer.pace_frame();
+
+        std::chrono::steady_clock::time_point frame_begin = std::chrono::steady_clock::now();
+        render_frame(scene, renderer);
+        cpu_ms += elapsed_ms(frame_begin);
+    }
+    renderer.wait_idle();
+    f64 run_ms = elapsed_ms(run_begin);
+
+    result.frames_per_second = run_ms > 0.0 ? frame_count * 1000.0 / run_ms : 0.0;
+    result.cpu_ms_per_frame = frame_count > 0 ? cpu_ms / frame_count : 0.0;
+
+    // Results land a frame late, so render once more to collect the last timed frame.
+    render_frame(scene, renderer);
+    renderer.wait_idle();
+    for (const tn::GpuScopeStats &scope : renderer.gpu_profiler().scope_stats()) {
+        if (scope.name == "frame") {
+            result.gpu_ms_per_frame = scope.average_ms;
+            result.gpu_p99_ms = scope.p99_ms;
+        }
+    }
+
+    result.peak_rss_bytes = peak_rss_bytes();
+    result.device_memory_bytes = renderer.memory_stats().reserved_bytes;
+
+    const tn::RenderGraphStats &graph = renderer.render_graph().stats();
+    result.graph_passes = graph.declared_passes - graph.culled_passes;
+    result.graph_barriers = graph.barriers;
+    result.graph_compile_ms = graph.compile_ms;
+    result.frame_data_high_water_bytes = renderer.frame_data_stats().high_water_bytes;
+
+    const tn::PipelineRegistryStats &pipelines = renderer.pipeline_stats();
+    result.pipeline_variants = pipelines.variants;
+    result.pipeline_build_ms = pipelines.last_build_ms;
+
+    const tn::ComputeStats &compute = renderer.compute_stats();
+    result.async_compute = compute.async;
+    result.compute_dispatches = compute.dispatches;
+
+    const tn::CullingStats &culling = renderer.culling_stats();
+    result.gpu_culling = culling.enabled;
+    result.culled_objects = culling.culled;
+
+    return result;
+}
+
+static bool write_results(const std::string &path, const std::vector<BenchResult> &results) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cout << "Could not open the file: " << path << std::endl;
+        return false;
+    }
+
+    file << "{\n  \"extent\": [" << bench_extent.width << ", " << bench_extent.height
+         << "],\n  \"scenes\": [";
+    for (usize i = 0; i < results.size(); i++) {
+        const BenchResult &result = results[i];
+        file << (i > 0 ? ",\n" : "\n") << "    {\"name\": \"" << result.scene
+             << "\", \"frames\": " << result.frames << ", \"startup_ms\": " << result.startup_ms
+             << ", \"fps\": " << result.frames_per_second
+             << ", \"cpu_ms_per_frame\": " << result.cpu_ms_per_frame
+             << ", \"gpu_ms_per_frame\": " << result.gpu_ms_per_frame
+             << ", \"gpu_p99_ms\": " << result.gpu_p99_ms
+             << ", \"peak_rss_bytes\": " << result.peak_rss_bytes
+             << ", \"device_memory_bytes\": " << result.device_memory_bytes
+             << ", \"graph_passes\": " << result.graph_passes
+             << ", \"graph_barriers\": " << result.graph_barriers
+             << ", \"graph_compile_ms\": " << result.graph_compile_ms
+             << ", \"frame_data_high_water_bytes\": " << result.frame_data_high_water_bytes
+             << ", \"pipeline_variants\": " << result.pipeline_variants
+             << ", \"pipeline_build_ms\": " << result.pipeline_build_ms
+             << ", \"async_compute\": " << (result.async_compute ? "true" : "false")
+             << ", \"compute_dispatches\": " << result.compute_dispatches
+             << ", \"gpu_culling\": " << (result.gpu_culling ? "true" : "false")
+             << ", \"culled_objects\": " << result.culled_objects << "}";
+    }
+    file << "\n  ]\n}\n";
+
+    return true;
+}
+
+// Usage: vulkan-tutorial-bench [--frames <count>] [--scene <name>] [--output <results.json>]
+//
+// To run on lavapipe, point the loader at its ICD, e.g.
+// VK_DRIVER_FILES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json.
+int main(int argc, char **argv) {
+    u32 frame_count = 300;
+    const char *scene_filter = nullptr;
+    std::string output_path = "bench_results.json";
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--frames") == 0) {
+            frame_count = static_cast<u32>(strtoul(argv[i + 1], nullptr, 10));
+        } else if (strcmp(argv[i], "--scene") == 0) {
+            scene_filter = argv[i + 1];
+        } else if (strcmp(argv[i], "--output") == 0) {
+            output_path = argv[i + 1];
+        }
+    }
+
+    std::vector<BenchResult> results;
+    for (const Scene &scene : scenes) {
+        if (scene_filter && strcmp(scene_filter, scene.name) != 0) {
+            continue;
+        }
+
+        results.push_back(run_scene(scene, frame_count));
+        const BenchResult &result = results.back();
+        std::cout << "[bench] " << result.scene << ": " << result.frames_per_second
+                  << " fps, cpu " << result.cpu_ms_per_frame << " ms, gpu "
+                  << result.gpu_ms_per_frame << " ms, startup " << result.startup_ms << " ms"
+                  << std::endl;
+    }
+
+    if (results.empty()) {
+        std::cout << "No scene named " << scene_filter << '.' << std::endl;
+        return 1;
+    }
+
+    // Frame time the async compute queue hides behind graphics work.
+    const BenchResult *async_result = nullptr;
+    const BenchResult *serial_result = nullptr;
+    for (const BenchResult &result : results) {
+        if (result.scene == "particles_async") {
+            async_result = &result;
+        } else if (result.scene == "particles_serial") {
+            serial_result = &result;
+        }
+    }
+    if (async_result && serial_result && async_result->frames_per_second > 0.0
+        && serial_result->frames_per_second > 0.0) {
+        f64 saved_ms = 1000.0 / serial_result->frames_per_second
+                       - 1000.0 / async_result->frames_per_second;
+        std::cout << "[bench] async compute overlap: " << saved_ms << " ms per frame"
+                  << (async_result->async_compute ? "" : " (no separate compute family)")
+                  << std::endl;
+    }
+
+    return write_results(output_path, results) ? 0 : 1;
+}
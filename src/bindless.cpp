@@ -0,0 +1,279 @@
+#include "bindless.h"
+
+#include <algorithm>
+#include <iostream>
+
+constexpr u32 max_bindless_buffers = 65536;
+constexpr u32 max_bindless_images = 65536;
+constexpr u32 max_bindless_samplers = 1024;
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    BindlessHeap::BindlessHeap()
+        : device{VK_NULL_HANDLE}, set_layout{VK_NULL_HANDLE}, pool{VK_NULL_HANDLE},
+          descriptor_set{VK_NULL_HANDLE}, slots{} {}
+
+    BindlessHeap::~BindlessHeap() {
+        this->destroy();
+    }
+
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT BindlessHeap::required_features() {
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+        features.runtimeDescriptorArray = VK_TRUE;
+        features.descriptorBindingPartiallyBound = VK_TRUE;
+        features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        return features;
+    }
+
+    void BindlessHeap::enable_core_features(VkPhysicalDeviceFeatures &features) {
+        features.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+    }
+
+    bool BindlessHeap::is_supported(VkPhysicalDevice physical_device) {
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexing{};
+        indexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &indexing;
+        vkGetPhysicalDeviceFeatures2(physical_device, &features);
+
+        return features.features.shaderStorageBufferArrayDynamicIndexing
+               && indexing.runtimeDescriptorArray && indexing.descriptorBindingPartiallyBound
+               && indexing.descriptorBindingUpdateUnusedWhilePending
+               && indexing.descriptorBindingStorageBufferUpdateAfterBind
+               && indexing.descriptorBindingSampledImageUpdateAfterBind;
+    }
+
+    void BindlessHeap::init(VkPhysicalDevice physical_device, VkDevice device) {
+        this->device = device;
+
+        VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexing{};
+        indexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+        VkPhysicalDeviceProperties2 properties{};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = &indexing;
+        vkGetPhysicalDeviceProperties2(physical_device, &properties);
+
+        // The whole array is visible to every stage, so the per-stage limit applies as well.
+        u32 buffers = std::min(
+            {max_bindless_buffers, indexing.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+             indexing.maxDescriptorSetUpdateAfterBindStorageBuffers}
+        );
+        u32 images = std::min(
+            {max_bindless_images, indexing.maxPerStageDescriptorUpdateAfterBindSampledImages,
+             indexing.maxDescriptorSetUpdateAfterBindSampledImages}
+        );
+        u32 samplers = std::min(
+            {max_bindless_samplers, indexing.maxPerStageDescriptorUpdateAfterBindSamplers,
+             indexing.maxDescriptorSetUpdateAfterBindSamplers}
+        );
+
+        VkDescriptorSetLayoutBinding bindings[3]{};
+        bindings[0].binding = STORAGE_BUFFER_BINDING;
+        bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[0].descriptorCount = buffers;
+        bindings[1].binding = SAMPLED_IMAGE_BINDING;
+        bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        bindings[1].descriptorCount = images;
+        bindings[2].binding = SAMPLER_BINDING;
+        bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+        bindings[2].descriptorCount = samplers;
+        for (VkDescriptorSetLayoutBinding &binding : bindings) {
+            binding.stageFlags = VK_SHADER_STAGE_ALL;
+        }
+
+        // Slots are written while command buffers using other slots of the same set are pending,
+        // and most slots are never written at all.
+        VkDescriptorBindingFlagsEXT binding_flags[3];
+        for (VkDescriptorBindingFlagsEXT &flags : binding_flags) {
+            flags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT
+                    | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT
+                    | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+        }
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flags_info{};
+        flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+        flags_info.bindingCount = 3;
+        flags_info.pBindingFlags = binding_flags;
+
+        VkDescriptorSetLayoutCreateInfo layout_info{};
+        layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layout_info.pNext = &flags_info;
+        layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+        layout_info.bindingCount = 3;
+        layout_info.pBindings = bindings;
+
+        if (vkCreateDescriptorSetLayout(this->device, &layout_info, nullptr, &this->set_layout)
+            != VK_SUCCESS) {
+            std::cout << "Failed to create bindless descriptor set layout." << std::endl;
+            return;
+        }
+
+        VkDescriptorPoolSize pool_sizes[3]{};
+        for (u32 i = 0; i < 3; i++) {
+            pool_sizes[i].type = bindings[i].descriptorType;
+            pool_sizes[i].descriptorCount = bindings[i].descriptorCount;
+        }
+
+        VkDescriptorPoolCreateInfo pool_info{};
+        pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+        pool_info.maxSets = 1;
+        pool_info.poolSizeCount = 3;
+        pool_info.pPoolSizes = pool_sizes;
+
+        if (vkCreateDescriptorPool(this->device, &pool_info, nullptr, &this->pool)
+            != VK_SUCCESS) {
+            std::cout << "Failed to create bindless descriptor pool." << std::endl;
+            return;
+        }
+
+        VkDescriptorSetAllocateInfo alloc_info{};
+        alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        alloc_info.descriptorPool = this->pool;
+        alloc_info.descriptorSetCount = 1;
+        alloc_info.pSetLayouts = &this->set_layout;
+
+        if (vkAllocateDescriptorSets(this->device, &alloc_info, &this->descriptor_set)
+            != VK_SUCCESS) {
+            std::cout << "Failed to allocate bindless descriptor set." << std::endl;
+            return;
+        }
+
+        this->slots[static_cast<u32>(BindlessKind::StorageBuffer)] = Slots{buffers, 0, {}};
+        this->slots[static_cast<u32>(BindlessKind::SampledImage)] = Slots{images, 0, {}};
+        this->slots[static_cast<u32>(BindlessKind::Sampler)] = Slots{samplers, 0, {}};
+
+        std::cout << "Successfully created bindless heap (" << buffers << " buffers, " << images
+                  << " images, " << samplers << " samplers)." << std::endl;
+    }
+
+    void BindlessHeap::destroy() {
+        if (this->device == VK_NULL_HANDLE) {
+            return;
+        }
+
+        // Destroying the pool frees the set.
+        vkDestroyDescriptorPool(this->device, this->pool, nullptr);
+        vkDestroyDescriptorSetLayout(this->device, this->set_layout, nullptr);
+        this->pool = VK_NULL_HANDLE;
+        this->set_layout = VK_NULL_HANDLE;
+        this->descriptor_set = VK_NULL_HANDLE;
+        for (Slots &slots : this->slots) {
+            slots = Slots{};
+        }
+        this->device = VK_NULL_HANDLE;
+
+        std::cout << "Destroyed bindless heap.\n";
+    }
+
+    u32 BindlessHeap::add_storage_buffer(
+        VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range
+    ) {
+        u32 index = this->slots[static_cast<u32>(BindlessKind::StorageBuffer)].allocate();
+        if (index == INVALID_INDEX) {
+            return index;
+        }
+
+        VkDescriptorBufferInfo buffer_info{};
+        buffer_info.buffer = buffer;
+        buffer_info.offset = offset;
+        buffer_info.range = range;
+
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = this->descriptor_set;
+        write.dstBinding = STORAGE_BUFFER_BINDING;
+        write.dstArrayElement = index;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.pBufferInfo = &buffer_info;
+        vkUpdateDescriptorSets(this->device, 1, &write, 0, nullptr);
+
+        return index;
+    }
+
+    u32 BindlessHeap::add_sampled_image(VkImageView image_view, VkImageLayout layout) {
+        u32 index = this->slots[static_cast<u32>(BindlessKind::SampledImage)].allocate();
+        if (index == INVALID_INDEX) {
+            return index;
+        }
+
+        VkDescriptorImageInfo image_info{};
+        image_info.imageView = image_view;
+        image_info.imageLayout = layout;
+
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = this->descriptor_set;
+        write.dstBinding = SAMPLED_IMAGE_BINDING;
+        write.dstArrayElement = index;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        write.pImageInfo = &image_info;
+        vkUpdateDescriptorSets(this->device, 1, &write, 0, nullptr);
+
+        return index;
+    }
+
+    u32 BindlessHeap::add_sampler(VkSampler sampler) {
+        u32 index = this->slots[static_cast<u32>(BindlessKind::Sampler)].allocate();
+        if (index == INVALID_INDEX) {
+            return index;
+        }
+
+        VkDescriptorImageInfo image_info{};
+        image_info.sampler = sampler;
+
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = this->descriptor_set;
+        write.dstBinding = SAMPLER_BINDING;
+        write.dstArrayElement = index;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+        write.pImageInfo = &image_info;
+        vkUpdateDescriptorSets(this->device, 1, &write, 0, nullptr);
+
+        return index;
+    }
+
+    void BindlessHeap::release(BindlessKind kind, u32 index) {
+        if (index != INVALID_INDEX) {
+            this->slots[static_cast<u32>(kind)].free.push_back(index);
+        }
+    }
+
+    VkDescriptorSetLayout BindlessHeap::layout() const {
+        return this->set_layout;
+    }
+
+    VkDescriptorSet BindlessHeap::set() const {
+        return this->descriptor_set;
+    }
+
+    u32 BindlessHeap::capacity(BindlessKind kind) const {
+        return this->slots[static_cast<u32>(kind)].capacity;
+    }
+
+    u32 BindlessHeap::used(BindlessKind kind) const {
+        const Slots &slots = this->slots[static_cast<u32>(kind)];
+        return slots.next - static_cast<u32>(slots.free.size());
+    }
+
+    u32 BindlessHeap::Slots::allocate() {
+        if (!this->free.empty()) {
+            u32 index = this->free.back();
+            this->free.pop_back();
+            return index;
+        }
+        if (this->next < this->capacity) {
+            return this->next++;
+        }
+        return INVALID_INDEX;
+    }
+} // namespace TANELORN_ENGINE_NAMESPACE
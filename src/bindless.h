@@ -0,0 +1,71 @@
+#pragma once
+
+#include "defines.h"
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    enum class BindlessKind {
+        StorageBuffer,
+        SampledImage,
+        Sampler,
+    };
+
+    // One update-after-bind descriptor set holding every storage buffer, sampled image and
+    // sampler the renderer uses, in three runtime-sized arrays. Resources are referred to by
+    // their index in the array, usually passed to shaders through push constants, so drawing
+    // never allocates or binds per-draw descriptor sets. Freed indices are reused.
+    class BindlessHeap {
+    public:
+        static constexpr u32 STORAGE_BUFFER_BINDING = 0;
+        static constexpr u32 SAMPLED_IMAGE_BINDING = 1;
+        static constexpr u32 SAMPLER_BINDING = 2;
+        static constexpr u32 INVALID_INDEX = UINT32_MAX;
+
+        BindlessHeap();
+        ~BindlessHeap();
+
+        BindlessHeap(const BindlessHeap &) = delete;
+        BindlessHeap &operator=(const BindlessHeap &) = delete;
+
+        // The descriptor indexing features the heap needs, to chain into VkDeviceCreateInfo.
+        static VkPhysicalDeviceDescriptorIndexingFeaturesEXT required_features();
+        // Shaders index the storage buffer array with push constants, which needs dynamic
+        // indexing on top of descriptor indexing.
+        static void enable_core_features(VkPhysicalDeviceFeatures &features);
+        static bool is_supported(VkPhysicalDevice physical_device);
+
+        void init(VkPhysicalDevice physical_device, VkDevice device);
+        void destroy();
+
+        // Return INVALID_INDEX when the array is full.
+        u32 add_storage_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+        u32 add_sampled_image(VkImageView image_view, VkImageLayout layout);
+        u32 add_sampler(VkSampler sampler);
+        // The index may be handed out again right away, so the device must be done with it.
+        void release(BindlessKind kind, u32 index);
+
+        VkDescriptorSetLayout layout() const;
+        VkDescriptorSet set() const;
+        u32 capacity(BindlessKind kind) const;
+        u32 used(BindlessKind kind) const;
+
+    private:
+        struct Slots {
+            u32 capacity;
+            u32 next;
+            std::vector<u32> free;
+
+            u32 allocate();
+        };
+
+        VkDevice device;
+        VkDescriptorSetLayout set_layout;
+        VkDescriptorPool pool;
+        VkDescriptorSet descriptor_set;
+        // Indexed by BindlessKind.
+        Slots slots[3];
+    };
+} // namespace TANELORN_ENGINE_NAMESPACE
@@ -0,0 +1,311 @@
+#include "compute.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    void record_buffer_ownership_transfer(
+        VkCommandBuffer command_buffer, VkBuffer buffer, u32 src_family, u32 dst_family,
+        VkPipelineStageFlags src_stages, VkAccessFlags src_access,
+        VkPipelineStageFlags dst_stages, VkAccessFlags dst_access
+    ) {
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = src_access;
+        barrier.dstAccessMask = dst_access;
+        barrier.srcQueueFamilyIndex = src_family;
+        barrier.dstQueueFamilyIndex = dst_family;
+        barrier.buffer = buffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+
+        // The half without stages only has to be ordered by the semaphore, which
+        // TOP_OF_PIPE and BOTTOM_OF_PIPE express without blocking anything.
+        vkCmdPipelineBarrier(
+            command_buffer, src_stages ? src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            dst_stages ? dst_stages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1,
+            &barrier, 0, nullptr
+        );
+    }
+
+    AsyncCompute::AsyncCompute()
+        : device{VK_NULL_HANDLE}, layout{VK_NULL_HANDLE}, set{VK_NULL_HANDLE}, queue_family{0},
+          graphics_timeline{nullptr}, command_pool{VK_NULL_HANDLE}, frame{0}, recording{false},
+          frame_commands{0}, pending_stages{0}, pending_access{0}, cache{nullptr},
+          compute_stats{} {}
+
+    AsyncCompute::~AsyncCompute() {
+        this->destroy();
+    }
+
+    void AsyncCompute::init(
+        VkDevice device, const PipelineCache &cache, VkDescriptorSetLayout set_layout,
+        VkDescriptorSet set, u32 family, VkQueue queue, u32 frames_in_flight,
+        QueueTimeline *graphics_timeline
+    ) {
+        bool async = graphics_timeline == nullptr;
+        this->device = device;
+        this->cache = &cache;
+        this->set = set;
+        this->queue_family = family;
+        this->compute_timeline.init(device, queue);
+        this->graphics_timeline = graphics_timeline;
+        this->compute_stats = ComputeStats{};
+        this->compute_stats.async = async;
+
+        VkPushConstantRange push_constant_range{};
+        push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        push_constant_range.offset = 0;
+        push_constant_range.size = COMPUTE_PUSH_CONSTANT_SIZE;
+
+        VkPipelineLayoutCreateInfo layout_info{};
+        layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layout_info.setLayoutCount = 1;
+        layout_info.pSetLayouts = &set_layout;
+        layout_info.pushConstantRangeCount = 1;
+        layout_info.pPushConstantRanges = &push_constant_range;
+        vkCreatePipelineLayout(this->device, &layout_info, nullptr, &this->layout);
+
+        VkCommandPoolCreateInfo pool_info{};
+        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        pool_info.queueFamilyIndex = family;
+        vkCreateCommandPool(this->device, &pool_info, nullptr, &this->command_pool);
+
+        this->command_buffers.resize(frames_in_flight);
+        VkCommandBufferAllocateInfo alloc_info{};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool = this->command_pool;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandBufferCount = frames_in_flight;
+        VkResult res =
+            vkAllocateCommandBuffers(this->device, &alloc_info, this->command_buffers.data());
+        this->frame_values.assign(frames_in_flight, 0);
+
+        if (res == VK_SUCCESS) {
+            std::cout << "Successfully created " << (async ? "async" : "graphics queue")
+                      << " compute on queue family " << family << '.' << std::endl;
+        } else {
+            std::cout << "Failed to create compute command buffers: " << res << std::endl;
+        }
+    }
+
+    void AsyncCompute::destroy() {
+        if (this->device == VK_NULL_HANDLE) {
+            return;
+        }
+
+        vkQueueWaitIdle(this->compute_timeline.queue());
+        for (VkPipeline pipeline : this->pipelines) {
+            vkDestroyPipeline(this->device, pipeline, nullptr);
+        }
+        this->pipelines.clear();
+        vkDestroyPipelineLayout(this->device, this->layout, nullptr);
+        vkDestroyCommandPool(this->device, this->command_pool, nullptr);
+        this->command_buffers.clear();
+        this->compute_timeline.destroy();
+        this->recording = false;
+        this->device = VK_NULL_HANDLE;
+
+        std::cout << "Destroyed compute.\n";
+    }
+
+    u32 AsyncCompute::create_pipeline(const SpirvCode &code) {
+        VkShaderModuleCreateInfo module_info{};
+        module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        module_info.codeSize = code.size();
+        module_info.pCode = code.words();
+
+        VkShaderModule module;
+        if (code.empty()
+            || vkCreateShaderModule(this->device, &module_info, nullptr, &module) != VK_SUCCESS) {
+            std::cout << "Failed to create compute shader module." << std::endl;
+            return UINT32_MAX;
+        }
+
+        VkComputePipelineCreateInfo create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        create_info.stage.module = module;
+        create_info.stage.pName = "main";
+        create_info.layout = this->layout;
+
+        VkPipeline pipeline;
+        VkResult res = vkCreateComputePipelines(
+            this->device, this->cache->handle(), 1, &create_info, nullptr, &pipeline
+        );
+        vkDestroyShaderModule(this->device, module, nullptr);
+        if (res != VK_SUCCESS) {
+            std::cout << "Failed to create compute pipeline: " << res << std::endl;
+            return UINT32_MAX;
+        }
+
+        this->pipelines.push_back(pipeline);
+        this->compute_stats.pipelines = static_cast<u32>(this->pipelines.size());
+        return static_cast<u32>(this->pipelines.size() - 1);
+    }
+
+    void AsyncCompute::begin_frame(u32 frame) {
+        if (this->recording) {
+            vkEndCommandBuffer(this->command_buffers[this->frame]);
+        }
+        this->timeline().wait(this->frame_values[frame]);
+
+        this->frame = frame;
+        this->frame_commands = 0;
+        this->pending_stages = 0;
+        this->pending_access = 0;
+
+        VkCommandBuffer command_buffer = this->command_buffers[frame];
+        vkResetCommandBuffer(command_buffer, 0);
+
+        VkCommandBufferBeginInfo begin_info{};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(command_buffer, &begin_info);
+
+        vkCmdBindDescriptorSets(
+            command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->layout, 0, 1, &this->set, 0,
+            nullptr
+        );
+        this->recording = true;
+    }
+
+    void AsyncCompute::dispatch(
+        u32 pipeline, u32 groups_x, u32 groups_y, u32 groups_z, const void *push_constants,
+        u32 push_constant_size
+    ) {
+        if (!this->recording || pipeline >= this->pipelines.size()) {
+            return;
+        }
+
+        VkCommandBuffer command_buffer = this->command_buffers[this->frame];
+        if (this->pending_stages) {
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = this->pending_access;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            vkCmdPipelineBarrier(
+                command_buffer, this->pending_stages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                1, &barrier, 0, nullptr, 0, nullptr
+            );
+        }
+
+        vkCmdBindPipeline(
+            command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->pipelines[pipeline]
+        );
+        if (push_constants && push_constant_size > 0) {
+            vkCmdPushConstants(
+                command_buffer, this->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                std::min(push_constant_size, COMPUTE_PUSH_CONSTANT_SIZE), push_constants
+            );
+        }
+        vkCmdDispatch(command_buffer, groups_x, groups_y, groups_z);
+
+        this->pending_stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        this->pending_access = VK_ACCESS_SHADER_WRITE_BIT;
+        this->frame_commands++;
+        this->compute_stats.dispatches++;
+    }
+
+    void AsyncCompute::fill(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, u32 value) {
+        if (!this->recording) {
+            return;
+        }
+
+        VkCommandBuffer command_buffer = this->command_buffers[this->frame];
+        if (this->pending_stages & VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT) {
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = this->pending_access;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            vkCmdPipelineBarrier(
+                command_buffer, this->pending_stages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1,
+                &barrier, 0, nullptr, 0, nullptr
+            );
+            this->pending_stages = 0;
+            this->pending_access = 0;
+        }
+
+        vkCmdFillBuffer(command_buffer, buffer, offset, size, value);
+
+        this->pending_stages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+        this->pending_access |= VK_ACCESS_TRANSFER_WRITE_BIT;
+        this->frame_commands++;
+    }
+
+    void AsyncCompute::acquire(VkBuffer buffer, u32 src_family) {
+        if (!this->recording) {
+            return;
+        }
+
+        record_buffer_ownership_transfer(
+            this->command_buffers[this->frame], buffer, src_family, this->queue_family, 0, 0,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT
+        );
+        this->frame_commands++;
+    }
+
+    void AsyncCompute::release(VkBuffer buffer, u32 dst_family) {
+        if (!this->recording) {
+            return;
+        }
+
+        record_buffer_ownership_transfer(
+            this->command_buffers[this->frame], buffer, this->queue_family, dst_family,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, 0, 0
+        );
+        this->frame_commands++;
+    }
+
+    u64 AsyncCompute::submit(VkPipelineStageFlags dst_stages, VkAccessFlags dst_access) {
+        if (!this->recording) {
+            return 0;
+        }
+
+        VkCommandBuffer command_buffer = this->command_buffers[this->frame];
+        if (this->graphics_timeline && this->frame_commands > 0 && this->pending_stages) {
+            // Commands later in submission order, in the frame's own command buffers, are
+            // inside this barrier's second scope.
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = this->pending_access;
+            barrier.dstAccessMask = dst_access;
+            vkCmdPipelineBarrier(
+                command_buffer, this->pending_stages, dst_stages, 0, 1, &barrier, 0, nullptr, 0,
+                nullptr
+            );
+        }
+        vkEndCommandBuffer(command_buffer);
+        this->recording = false;
+        if (this->frame_commands == 0) {
+            return 0;
+        }
+
+        if (this->graphics_timeline) {
+            this->graphics_timeline->add_command_buffer(command_buffer);
+            this->frame_values[this->frame] = this->graphics_timeline->next_value();
+            return 0;
+        }
+
+        this->compute_timeline.add_command_buffer(command_buffer);
+        this->frame_values[this->frame] = this->compute_timeline.submit();
+        this->compute_stats.submissions++;
+        return this->frame_values[this->frame];
+    }
+
+    u32 AsyncCompute::family() const {
+        return this->queue_family;
+    }
+
+    QueueTimeline &AsyncCompute::timeline() {
+        return this->graphics_timeline ? *this->graphics_timeline : this->compute_timeline;
+    }
+
+    const ComputeStats &AsyncCompute::stats() const {
+        return this->compute_stats;
+    }
+} // namespace TANELORN_ENGINE_NAMESPACE
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "allocator.h"
+#include "defines.h"
+#include "pipeline_cache.h"
+#include "shader_manager.h"
+#include "timeline.h"
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    // Size of the push constant block shared by every compute pipeline.
+    constexpr u32 COMPUTE_PUSH_CONSTANT_SIZE = 128;
+
+    struct ComputeStats {
+        u32 pipelines;
+        u64 dispatches;
+        u64 submissions;
+        // True when dispatches run on a queue family of their own, alongside graphics work.
+        bool async;
+    };
+
+    // A storage buffer written by compute dispatches and read by draws of the same frame. There
+    // is one copy per frame in flight, so a frame's dispatches never overwrite what an earlier
+    // frame is still drawing from.
+    struct ComputeBuffer {
+        std::vector<VkBuffer> buffers;
+        std::vector<Allocation> allocations;
+        // Slot of each copy in the bindless storage buffer array.
+        std::vector<u32> bindless_indices;
+        // Whether each copy was last acquired by the graphics family, and so has to be acquired
+        // back before the compute family touches it again.
+        std::vector<bool> graphics_owned;
+        VkDeviceSize size;
+    };
+
+    // Records one half of a queue family ownership transfer of `buffer`. The releasing queue
+    // records it with empty destination stages and access, the acquiring queue with empty
+    // source stages and access; a semaphore orders the two submissions.
+    void record_buffer_ownership_transfer(
+        VkCommandBuffer command_buffer, VkBuffer buffer, u32 src_family, u32 dst_family,
+        VkPipelineStageFlags src_stages, VkAccessFlags src_access,
+        VkPipelineStageFlags dst_stages, VkAccessFlags dst_access
+    );
+
+    // Compute pipelines and the per-frame submission of their dispatches. On a device with a
+    // compute family separate from graphics, the work goes to that family's queue with its own
+    // timeline and runs concurrently with the graphics work of earlier frames; graphics waits on
+    // it right before the stages that read the results. Otherwise it joins the frame's graphics
+    // submission, ahead of the frame's own command buffers, so it costs no submission of its own.
+    class AsyncCompute {
+    public:
+        AsyncCompute();
+        ~AsyncCompute();
+
+        AsyncCompute(const AsyncCompute &) = delete;
+        AsyncCompute &operator=(const AsyncCompute &) = delete;
+
+        // `set` is bound to every dispatch as set 0. `graphics_timeline` is null when `queue`
+        // belongs to a compute family of its own, and the graphics queue's timeline when
+        // compute shares that queue.
+        void init(
+            VkDevice device, const PipelineCache &cache, VkDescriptorSetLayout set_layout,
+            VkDescriptorSet set, u32 family, VkQueue queue, u32 frames_in_flight,
+            QueueTimeline *graphics_timeline
+        );
+        void destroy();
+
+        // Returns UINT32_MAX when the pipeline could not be created.
+        u32 create_pipeline(const SpirvCode &code);
+
+        // Starts recording frame slot `frame`, whose previous submission must have completed.
+        // Calling it again for the same slot discards what was recorded since.
+        void begin_frame(u32 frame);
+        // Dispatches are ordered: each one sees the writes of the dispatches and fills before it.
+        void dispatch(
+            u32 pipeline, u32 groups_x, u32 groups_y, u32 groups_z, const void *push_constants,
+            u32 push_constant_size
+        );
+        // Sets `size` bytes of `buffer` from `offset` to the repeated word `value`, after the
+        // dispatches recorded so far. Fills recorded back to back are not ordered among
+        // themselves, so consecutive fills must not overlap.
+        void fill(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, u32 value);
+        // Takes `buffer` over from `src_family` ahead of this frame's dispatches. Call it
+        // before the first dispatch that touches the buffer.
+        void acquire(VkBuffer buffer, u32 src_family);
+        // Hands `buffer` over to `dst_family` after this frame's dispatches.
+        void release(VkBuffer buffer, u32 dst_family);
+        // Ends the frame. On a queue of its own it is submitted, and the compute timeline value
+        // graphics has to wait for is returned. Sharing the graphics queue, it is added to the
+        // next graphics submission behind a barrier to `dst_stages` and `dst_access` instead,
+        // and 0 is returned, as it is when nothing was recorded.
+        u64 submit(VkPipelineStageFlags dst_stages, VkAccessFlags dst_access);
+
+        u32 family() const;
+        // The timeline the frame's dispatches go out on, to add waits to.
+        QueueTimeline &timeline();
+        const ComputeStats &stats() const;
+
+    private:
+        VkDevice device;
+        VkPipelineLayout layout;
+        VkDescriptorSet set;
+        u32 queue_family;
+        QueueTimeline compute_timeline;
+        // Null when compute has a queue of its own.
+        QueueTimeline *graphics_timeline;
+        VkCommandPool command_pool;
+        std::vector<VkCommandBuffer> command_buffers;
+        // Value of `timeline()` each slot's command buffer was last submitted with.
+        std::vector<u64> frame_values;
+        u32 frame;
+        bool recording;
+        // Dispatches, fills and barriers recorded this frame; an empty frame is not submitted.
+        u32 frame_commands;
+        // Stages and access of the writes recorded since the last barrier.
+        VkPipelineStageFlags pending_stages;
+        VkAccessFlags pending_access;
+        const PipelineCache *cache;
+        std::vector<VkPipeline> pipelines;
+        ComputeStats compute_stats;
+    };
+} // namespace TANELORN_ENGINE_NAMESPACE
@@ -0,0 +1,162 @@
+#include "cpu_profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    void write_json_string(std::ostream &out, const char *value) {
+        static const char hex_digits[] = "0123456789abcdef";
+
+        out << '"';
+        for (const char *c = value; *c; c++) {
+            unsigned char byte = static_cast<unsigned char>(*c);
+            if (*c == '"' || *c == '\\') {
+                out << '\\' << *c;
+            } else if (byte < 0x20) {
+                out << "\\u00" << hex_digits[byte >> 4] << hex_digits[byte & 0xf];
+            } else {
+                out << *c;
+            }
+        }
+        out << '"';
+    }
+
+    CpuProfiler &CpuProfiler::get() {
+        static CpuProfiler profiler;
+        return profiler;
+    }
+
+    CpuProfiler::CpuProfiler() : frame_number{0}, start_ns{0} {
+        this->start_ns = this->now_ns();
+    }
+
+    void CpuProfiler::begin_frame() {
+        this->frame_number.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void CpuProfiler::record(const char *name, u64 begin_ns, u64 end_ns) {
+        ThreadRing &ring = this->thread_ring();
+        u64 head = ring.head.load(std::memory_order_relaxed);
+
+        Slot &slot = ring.slots[head % RING_SIZE];
+        slot.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.begin_ns.store(begin_ns, std::memory_order_relaxed);
+        slot.end_ns.store(end_ns, std::memory_order_relaxed);
+        slot.frame.store(
+            this->frame_number.load(std::memory_order_relaxed), std::memory_order_relaxed
+        );
+        slot.sequence.store(head + 1, std::memory_order_release);
+
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+
+    u64 CpuProfiler::now_ns() const {
+        std::chrono::nanoseconds since_epoch = std::chrono::steady_clock::now().time_since_epoch();
+        return static_cast<u64>(since_epoch.count());
+    }
+
+    std::vector<CpuScopeStats> CpuProfiler::frame_stats() const {
+        std::vector<CpuScopeStats> stats;
+        u64 frame = this->frame_number.load(std::memory_order_relaxed);
+        if (frame == 0) {
+            return stats;
+        }
+
+        this->for_each_event([&](u32, const Event &event) {
+            if (event.frame != frame - 1) {
+                return;
+            }
+
+            auto it = std::find_if(stats.begin(), stats.end(), [&](const CpuScopeStats &s) {
+                return s.name == event.name;
+            });
+            if (it == stats.end()) {
+                stats.push_back(CpuScopeStats{event.name, 0, 0.0});
+                it = stats.end() - 1;
+            }
+            it->count++;
+            it->total_ms += (event.end_ns - event.begin_ns) / 1e6;
+        });
+
+        std::sort(stats.begin(), stats.end(), [](const CpuScopeStats &a, const CpuScopeStats &b) {
+            return a.total_ms > b.total_ms;
+        });
+        return stats;
+    }
+
+    bool CpuProfiler::write_chrome_trace(const std::string &path) const {
+        std::ofstream file(path);
+        if (!file.is_open()) {
+            std::cout << "Could not open the file: " << path << std::endl;
+            return false;
+        }
+
+        usize event_count = 0;
+        file << "{\"traceEvents\":[";
+        this->for_each_event([&](u32 thread_index, const Event &event) {
+            file << (event_count > 0 ? ",\n" : "\n") << "{\"name\":";
+            write_json_string(file, event.name);
+            file << ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread_index
+                 << ",\"ts\":" << (event.begin_ns - this->start_ns) / 1e3
+                 << ",\"dur\":" << (event.end_ns - event.begin_ns) / 1e3
+                 << ",\"args\":{\"frame\":" << event.frame << "}}";
+            event_count++;
+        });
+        file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+        std::cout << "Wrote " << event_count << " CPU trace events to " << path << '.'
+                  << std::endl;
+        return true;
+    }
+
+    CpuProfiler::ThreadRing &CpuProfiler::thread_ring() {
+        thread_local ThreadRing *ring = nullptr;
+
+        if (!ring) {
+            std::unique_ptr<ThreadRing> created = std::make_unique<ThreadRing>();
+            created->slots = std::make_unique<Slot[]>(RING_SIZE);
+            created->head.store(0, std::memory_order_relaxed);
+
+            std::lock_guard<std::mutex> lock(this->mutex);
+            created->thread_index = static_cast<u32>(this->rings.size());
+            ring = created.get();
+            this->rings.push_back(std::move(created));
+        }
+
+        return *ring;
+    }
+
+    template <typename F> void CpuProfiler::for_each_event(F &&visit) const {
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        for (const std::unique_ptr<ThreadRing> &ring : this->rings) {
+            u64 head = ring->head.load(std::memory_order_acquire);
+            u64 first = head > RING_SIZE ? head - RING_SIZE : 0;
+
+            for (u64 i = first; i < head; i++) {
+                const Slot &slot = ring->slots[i % RING_SIZE];
+                if (slot.sequence.load(std::memory_order_acquire) != i + 1) {
+                    continue;
+                }
+
+                Event event{};
+                event.name = slot.name.load(std::memory_order_relaxed);
+                event.begin_ns = slot.begin_ns.load(std::memory_order_relaxed);
+                event.end_ns = slot.end_ns.load(std::memory_order_relaxed);
+                event.frame = slot.frame.load(std::memory_order_relaxed);
+
+                // The owner may have started rewriting the entry while it was copied.
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.sequence.load(std::memory_order_relaxed) != i + 1) {
+                    continue;
+                }
+
+                visit(ring->thread_index, event);
+            }
+        }
+    }
+} // namespace TANELORN_ENGINE_NAMESPACE
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "defines.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    struct CpuScopeStats {
+        const char *name;
+        u32 count;
+        f64 total_ms;
+    };
+
+    // Writes `value` as a quoted JSON string. Shared by the Chrome trace exporters.
+    void write_json_string(std::ostream &out, const char *value);
+
+    // Records named CPU scopes into a fixed ring per thread. Recording never locks; a thread
+    // only takes the registry lock the first time it records. Aggregation and export read every
+    // ring and are meant to run between frames. Entries a thread overwrites while they are
+    // being read are dropped rather than reported torn.
+    //
+    // Use it through TN_PROFILE_SCOPE and TN_PROFILE_FRAME, which compile to nothing in
+    // TN_RELEASE builds.
+    class CpuProfiler {
+    public:
+        static constexpr u32 RING_SIZE = 16384;
+
+        static CpuProfiler &get();
+
+        // Marks the start of a new frame. Call once per frame from the main loop.
+        void begin_frame();
+        void record(const char *name, u64 begin_ns, u64 end_ns);
+        u64 now_ns() const;
+
+        // Time per scope name summed over all threads for the last completed frame, longest
+        // first.
+        std::vector<CpuScopeStats> frame_stats() const;
+        // Writes every retained event in the Chrome trace event format, one track per thread.
+        bool write_chrome_trace(const std::string &path) const;
+
+    private:
+        struct Event {
+            const char *name;
+            u64 begin_ns;
+            u64 end_ns;
+            u64 frame;
+        };
+
+        // One ring entry. Readers run concurrently with the owning thread, so every field is
+        // atomic and `sequence` brackets the writes like a seqlock.
+        struct Slot {
+            // Index + 1 of the event held, 0 while the owner is rewriting it.
+            std::atomic<u64> sequence;
+            std::atomic<const char *> name;
+            std::atomic<u64> begin_ns;
+            std::atomic<u64> end_ns;
+            std::atomic<u64> frame;
+        };
+
+        struct ThreadRing {
+            u32 thread_index;
+            std::unique_ptr<Slot[]> slots;
+            // Total events ever written. Only the owning thread stores to it.
+            std::atomic<u64> head;
+        };
+
+        CpuProfiler();
+
+        ThreadRing &thread_ring();
+        template <typename F> void for_each_event(F &&visit) const;
+
+        mutable std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadRing>> rings;
+        std::atomic<u64> frame_number;
+        u64 start_ns;
+    };
+
+    class CpuProfileScope {
+    public:
+        explicit CpuProfileScope(const char *name)
+            : name{name}, begin_ns{CpuProfiler::get().now_ns()} {}
+
+        ~CpuProfileScope() {
+            CpuProfiler &profiler = CpuProfiler::get();
+            profiler.record(this->name, this->begin_ns, profiler.now_ns());
+        }
+
+        CpuProfileScope(const CpuProfileScope &) = delete;
+        CpuProfileScope &operator=(const CpuProfileScope &) = delete;
+
+    private:
+        const char *name;
+        u64 begin_ns;
+    };
+} // namespace TANELORN_ENGINE_NAMESPACE
+
+#ifdef TN_RELEASE
+#define TN_PROFILE_SCOPE(name)
+#define TN_PROFILE_FRAME()
+#else
+#define TN_PROFILE_CONCAT_INNER(a, b) a##b
+#define TN_PROFILE_CONCAT(a, b) TN_PROFILE_CONCAT_INNER(a, b)
+// `name` must be a string literal or otherwise outlive the profiler.
+#define TN_PROFILE_SCOPE(name)                                                                    \
+    ::TANELORN_ENGINE_NAMESPACE::CpuProfileScope TN_PROFILE_CONCAT(tn_profile_scope_, __LINE__) { \
+        name                                                                                      \
+    }
+#define TN_PROFILE_FRAME() ::TANELORN_ENGINE_NAMESPACE::CpuProfiler::get().begin_frame()
+#endif
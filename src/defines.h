@@ -1,8 +1,18 @@
+#pragma once
+
 #include <stdint.h>
 #include <stddef.h>
 
 #define TANELORN_ENGINE_NAMESPACE tn
 
+#if defined(_WIN32)
+#define TN_PLATFORM_WIN32
+#elif defined(__linux__)
+#define TN_PLATFORM_XCB
+#else
+#error "Unsupported platform."
+#endif
+
 typedef uint8_t u8;
 typedef uint16_t u16;
 typedef uint32_t u32;
@@ -0,0 +1,123 @@
+#include "frame_allocator.h"
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    FrameAllocator::FrameAllocator()
+        : device{VK_NULL_HANDLE}, allocator{nullptr}, ring_buffer{VK_NULL_HANDLE},
+          ring_allocation{}, min_alignment{1}, frame{0}, frame_head{0}, frame_stats{} {}
+
+    FrameAllocator::~FrameAllocator() {
+        this->destroy();
+    }
+
+    void FrameAllocator::init(
+        VkDevice device, GpuAllocator &allocator, u32 frames_in_flight,
+        VkDeviceSize min_alignment, VkDeviceSize frame_size
+    ) {
+        this->device = device;
+        this->allocator = &allocator;
+        this->min_alignment = std::max<VkDeviceSize>(min_alignment, 1);
+        // Keep every region starting on an aligned offset.
+        frame_size = (frame_size + this->min_alignment - 1) / this->min_alignment
+                     * this->min_alignment;
+
+        VkBufferCreateInfo create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        create_info.size = frame_size * frames_in_flight;
+        create_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(this->device, &create_info, nullptr, &this->ring_buffer)
+            != VK_SUCCESS) {
+            std::cout << "Failed to create frame allocator buffer." << std::endl;
+            return;
+        }
+
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(this->device, this->ring_buffer, &requirements);
+
+        // The GPU reads each byte about once, so device-local memory the CPU can write directly
+        // beats system memory when resizable BAR exposes it.
+        VkMemoryPropertyFlags host_properties =
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        VkMemoryPropertyFlags properties = host_properties | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        if (this->allocator->find_memory_type(requirements.memoryTypeBits, properties)
+            == UINT32_MAX) {
+            properties = host_properties;
+        }
+
+        if (!this->allocator->allocate(
+                requirements, properties, ResourceKind::Linear, this->ring_allocation
+            )) {
+            vkDestroyBuffer(this->device, this->ring_buffer, nullptr);
+            this->ring_buffer = VK_NULL_HANDLE;
+            return;
+        }
+        vkBindBufferMemory(
+            this->device, this->ring_buffer, this->ring_allocation.memory,
+            this->ring_allocation.offset
+        );
+
+        this->frame_stats = FrameAllocatorStats{};
+        this->frame_stats.frame_size = frame_size;
+        this->frame_stats.device_local = properties & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+        std::cout << "Successfully created frame allocator (" << (frame_size >> 10) << " KiB x "
+                  << frames_in_flight << ", "
+                  << (this->frame_stats.device_local ? "device local" : "host") << " memory)."
+                  << std::endl;
+    }
+
+    void FrameAllocator::destroy() {
+        if (this->device == VK_NULL_HANDLE) {
+            return;
+        }
+
+        if (this->ring_buffer != VK_NULL_HANDLE) {
+            this->allocator->destroy_buffer(this->ring_buffer, this->ring_allocation);
+            this->ring_buffer = VK_NULL_HANDLE;
+        }
+        this->device = VK_NULL_HANDLE;
+
+        std::cout << "Destroyed frame allocator.\n";
+    }
+
+    void FrameAllocator::begin_frame(u32 frame) {
+        this->frame_stats.last_frame_bytes = this->frame_head;
+        this->frame_stats.high_water_bytes =
+            std::max(this->frame_stats.high_water_bytes, this->frame_head);
+        this->frame = frame;
+        this->frame_head = 0;
+    }
+
+    FrameAllocation FrameAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+        // Callers may index the buffer by offset / alignment, so the offset into the whole buffer
+        // is what gets aligned, not the one into the frame's region.
+        alignment = std::lcm(std::max<VkDeviceSize>(alignment, 1), this->min_alignment);
+        VkDeviceSize region = this->frame * this->frame_stats.frame_size;
+        VkDeviceSize ring_offset =
+            (region + this->frame_head + alignment - 1) / alignment * alignment;
+        VkDeviceSize offset = ring_offset - region;
+
+        if (this->ring_buffer == VK_NULL_HANDLE || offset + size > this->frame_stats.frame_size) {
+            this->frame_stats.failed_allocations++;
+            return FrameAllocation{VK_NULL_HANDLE, 0, 0, nullptr};
+        }
+        this->frame_head = offset + size;
+
+        return FrameAllocation{
+            this->ring_buffer, ring_offset, size,
+            static_cast<u8 *>(this->ring_allocation.mapped) + ring_offset};
+    }
+
+    VkBuffer FrameAllocator::buffer() const {
+        return this->ring_buffer;
+    }
+
+    const FrameAllocatorStats &FrameAllocator::stats() const {
+        return this->frame_stats;
+    }
+} // namespace TANELORN_ENGINE_NAMESPACE
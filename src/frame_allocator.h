@@ -0,0 +1,69 @@
+#pragma once
+
+#include "allocator.h"
+#include "defines.h"
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    // A sub-range of the frame ring, valid until the same frame slot comes around again.
+    struct FrameAllocation {
+        VkBuffer buffer;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        // Null when the frame's region is exhausted.
+        void *mapped;
+    };
+
+    struct FrameAllocatorStats {
+        VkDeviceSize frame_size;
+        VkDeviceSize last_frame_bytes;
+        // Most bytes handed out in a single frame, including alignment padding.
+        VkDeviceSize high_water_bytes;
+        u64 failed_allocations;
+        // Whether the ring lives in device-local, host-visible memory (resizable BAR).
+        bool device_local;
+    };
+
+    // Linear allocator for data written by the CPU once per frame and read by the GPU in the
+    // same frame, such as per-frame constants and per-draw parameters. One persistently mapped
+    // buffer is split into a region per frame in flight; allocations bump a pointer through the
+    // current frame's region, which is rewound as a whole once that frame has completed.
+    class FrameAllocator {
+    public:
+        static constexpr VkDeviceSize DEFAULT_FRAME_SIZE = 4ull * 1024 * 1024;
+
+        FrameAllocator();
+        ~FrameAllocator();
+
+        FrameAllocator(const FrameAllocator &) = delete;
+        FrameAllocator &operator=(const FrameAllocator &) = delete;
+
+        // `min_alignment` is applied to every allocation, so offsets are always valid for
+        // binding as uniform or storage buffers. Offsets are aligned within the whole buffer.
+        void init(
+            VkDevice device, GpuAllocator &allocator, u32 frames_in_flight,
+            VkDeviceSize min_alignment, VkDeviceSize frame_size = DEFAULT_FRAME_SIZE
+        );
+        void destroy();
+
+        // The frame that last used `frame` must have completed on the GPU.
+        void begin_frame(u32 frame);
+        FrameAllocation allocate(VkDeviceSize size, VkDeviceSize alignment = 0);
+
+        VkBuffer buffer() const;
+        const FrameAllocatorStats &stats() const;
+
+    private:
+        VkDevice device;
+        GpuAllocator *allocator;
+        VkBuffer ring_buffer;
+        Allocation ring_allocation;
+        VkDeviceSize min_alignment;
+        u32 frame;
+        VkDeviceSize frame_head;
+        FrameAllocatorStats frame_stats;
+    };
+} // namespace TANELORN_ENGINE_NAMESPACE
@@ -0,0 +1,318 @@
+#include "gpu_profiler.h"
+
+#include "cpu_profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+// Oldest events are dropped beyond this, about a minute of a few scopes per frame at 60 fps.
+constexpr usize max_trace_events = 64 * 1024;
+
+// Bit order of the statistics, which is also the order the results are written in.
+constexpr VkQueryPipelineStatisticFlags pipeline_statistics_flags =
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT
+    | VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+    | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    GpuProfiler::GpuProfiler()
+        : device{VK_NULL_HANDLE}, timestamp_period_ns{0.0}, timestamp_mask{0},
+          statistics{false}, current{0}, frame_number{0}, scope_limit_warned{false},
+          last_pipeline_stats{} {}
+
+    GpuProfiler::~GpuProfiler() {
+        this->destroy();
+    }
+
+    void GpuProfiler::init(
+        VkPhysicalDevice physical_device, VkDevice device, u32 queue_family,
+        u32 frames_in_flight, bool statistics
+    ) {
+        this->device = device;
+        this->statistics = statistics;
+
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(physical_device, &props);
+        this->timestamp_period_ns = props.limits.timestampPeriod;
+
+        uint32_t family_count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+        std::vector<VkQueueFamilyProperties> families(family_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+
+        u32 valid_bits = families[queue_family].timestampValidBits;
+        this->timestamp_mask = valid_bits >= 64 ? UINT64_MAX : (1ull << valid_bits) - 1;
+
+        this->frames.resize(frames_in_flight);
+        for (Frame &frame : this->frames) {
+            frame.timestamp_pool = VK_NULL_HANDLE;
+            frame.statistics_pool = VK_NULL_HANDLE;
+            frame.statistics_written = false;
+            frame.submitted = false;
+
+            if (valid_bits > 0) {
+                VkQueryPoolCreateInfo create_info{};
+                create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+                create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+                create_info.queryCount = MAX_SCOPES * 2;
+                vkCreateQueryPool(this->device, &create_info, nullptr, &frame.timestamp_pool);
+            }
+
+            if (statistics) {
+                VkQueryPoolCreateInfo create_info{};
+                create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+                create_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+                create_info.queryCount = 1;
+                create_info.pipelineStatistics = pipeline_statistics_flags;
+                vkCreateQueryPool(this->device, &create_info, nullptr, &frame.statistics_pool);
+            }
+        }
+
+        if (valid_bits == 0) {
+            std::cout << "GPU profiler disabled: queue family " << queue_family
+                      << " does not support timestamps." << std::endl;
+        } else {
+            std::cout << "Successfully created GPU profiler ("
+                      << (statistics ? "with" : "without") << " pipeline statistics)."
+                      << std::endl;
+        }
+    }
+
+    void GpuProfiler::destroy() {
+        if (this->device == VK_NULL_HANDLE) {
+            return;
+        }
+
+        for (Frame &frame : this->frames) {
+            vkDestroyQueryPool(this->device, frame.timestamp_pool, nullptr);
+            vkDestroyQueryPool(this->device, frame.statistics_pool, nullptr);
+        }
+        this->frames.clear();
+        this->device = VK_NULL_HANDLE;
+
+        std::cout << "Destroyed GPU profiler.\n";
+    }
+
+    void GpuProfiler::begin_frame(u32 slot) {
+        this->current = slot;
+        Frame &frame = this->frames[slot];
+
+        if (frame.submitted) {
+            this->collect(frame);
+        }
+
+        frame.scope_names.clear();
+        frame.statistics_written = false;
+        frame.submitted = true;
+        this->frame_number++;
+    }
+
+    void GpuProfiler::reset_queries(VkCommandBuffer command_buffer) {
+        const Frame &frame = this->frames[this->current];
+
+        if (frame.timestamp_pool != VK_NULL_HANDLE) {
+            vkCmdResetQueryPool(command_buffer, frame.timestamp_pool, 0, MAX_SCOPES * 2);
+        }
+        if (frame.statistics_pool != VK_NULL_HANDLE) {
+            vkCmdResetQueryPool(command_buffer, frame.statistics_pool, 0, 1);
+        }
+    }
+
+    u32 GpuProfiler::add_name(const std::string &name) {
+        auto it = this->name_ids.find(name);
+        if (it != this->name_ids.end()) {
+            return it->second;
+        }
+
+        u32 name_id = static_cast<u32>(this->names.size());
+        this->names.push_back(name);
+        this->history.emplace_back();
+        this->name_ids.emplace(name, name_id);
+        return name_id;
+    }
+
+    u32 GpuProfiler::add_scope(const std::string &name) {
+        return this->add_scope(this->add_name(name));
+    }
+
+    u32 GpuProfiler::add_scope(u32 name) {
+        Frame &frame = this->frames[this->current];
+        if (frame.timestamp_pool == VK_NULL_HANDLE) {
+            return INVALID_SCOPE;
+        }
+        if (frame.scope_names.size() >= MAX_SCOPES) {
+            if (!this->scope_limit_warned) {
+                std::cout << "GPU profiler is out of scopes (" << MAX_SCOPES
+                          << " per frame); the rest are not timed." << std::endl;
+                this->scope_limit_warned = true;
+            }
+            return INVALID_SCOPE;
+        }
+
+        frame.scope_names.push_back(name);
+        return static_cast<u32>(frame.scope_names.size() - 1);
+    }
+
+    void GpuProfiler::write_begin(VkCommandBuffer command_buffer, u32 scope) const {
+        if (scope == INVALID_SCOPE) {
+            return;
+        }
+
+        vkCmdWriteTimestamp(
+            command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            this->frames[this->current].timestamp_pool, scope * 2
+        );
+    }
+
+    void GpuProfiler::write_end(VkCommandBuffer command_buffer, u32 scope) const {
+        if (scope == INVALID_SCOPE) {
+            return;
+        }
+
+        vkCmdWriteTimestamp(
+            command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            this->frames[this->current].timestamp_pool, scope * 2 + 1
+        );
+    }
+
+    void GpuProfiler::begin_statistics(VkCommandBuffer command_buffer) {
+        Frame &frame = this->frames[this->current];
+        if (!this->statistics || frame.statistics_written) {
+            return;
+        }
+
+        vkCmdBeginQuery(command_buffer, frame.statistics_pool, 0, 0);
+        frame.statistics_written = true;
+    }
+
+    void GpuProfiler::end_statistics(VkCommandBuffer command_buffer) {
+        const Frame &frame = this->frames[this->current];
+        if (!frame.statistics_written) {
+            return;
+        }
+
+        vkCmdEndQuery(command_buffer, frame.statistics_pool, 0);
+    }
+
+    bool GpuProfiler::statistics_enabled() const {
+        return this->statistics;
+    }
+
+    VkQueryPipelineStatisticFlags GpuProfiler::statistics_flags() const {
+        return this->statistics ? pipeline_statistics_flags : 0;
+    }
+
+    std::vector<GpuScopeStats> GpuProfiler::scope_stats() const {
+        std::vector<GpuScopeStats> result;
+
+        for (usize i = 0; i < this->names.size(); i++) {
+            const std::deque<f64> &samples = this->history[i];
+            if (samples.empty()) {
+                continue;
+            }
+
+            std::vector<f64> sorted(samples.begin(), samples.end());
+            std::sort(sorted.begin(), sorted.end());
+
+            f64 total = 0.0;
+            for (f64 sample : sorted) {
+                total += sample;
+            }
+
+            usize p99_index = (sorted.size() * 99 + 99) / 100 - 1;
+
+            GpuScopeStats stats{};
+            stats.name = this->names[i];
+            stats.sample_count = static_cast<u32>(sorted.size());
+            stats.min_ms = sorted.front();
+            stats.average_ms = total / sorted.size();
+            stats.p99_ms = sorted[std::min(p99_index, sorted.size() - 1)];
+            result.push_back(stats);
+        }
+
+        return result;
+    }
+
+    const GpuPipelineStats &GpuProfiler::pipeline_stats() const {
+        return this->last_pipeline_stats;
+    }
+
+    bool GpuProfiler::write_chrome_trace(const std::string &path) const {
+        std::ofstream file(path);
+        if (!file.is_open()) {
+            std::cout << "Could not open the file: " << path << std::endl;
+            return false;
+        }
+
+        file << "{\"traceEvents\":[";
+        for (usize i = 0; i < this->trace.size(); i++) {
+            const TraceEvent &event = this->trace[i];
+
+            file << (i > 0 ? ",\n" : "\n") << "{\"name\":";
+            write_json_string(file, this->names[event.name].c_str());
+            file << ",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":" << event.begin_us
+                 << ",\"dur\":" << event.duration_us << ",\"args\":{\"frame\":" << event.frame
+                 << "}}";
+        }
+        file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+        std::cout << "Wrote " << this->trace.size() << " GPU trace events to " << path << '.'
+                  << std::endl;
+        return true;
+    }
+
+    void GpuProfiler::collect(Frame &frame) {
+        usize scope_count = frame.scope_names.size();
+
+        if (scope_count > 0) {
+            std::vector<u64> timestamps(scope_count * 2);
+            VkResult res = vkGetQueryPoolResults(
+                this->device, frame.timestamp_pool, 0, static_cast<uint32_t>(scope_count * 2),
+                timestamps.size() * sizeof(u64), timestamps.data(), sizeof(u64),
+                VK_QUERY_RESULT_64_BIT
+            );
+
+            if (res == VK_SUCCESS) {
+                // The frame that wrote these was numbered `frames_in_flight` frames ago.
+                u64 frame_number = this->frame_number - this->frames.size() + 1;
+
+                for (usize i = 0; i < scope_count; i++) {
+                    u64 begin = timestamps[i * 2] & this->timestamp_mask;
+                    u64 end = timestamps[i * 2 + 1] & this->timestamp_mask;
+                    f64 duration_ns =
+                        static_cast<f64>((end - begin) & this->timestamp_mask)
+                        * this->timestamp_period_ns;
+
+                    u32 name = frame.scope_names[i];
+                    std::deque<f64> &samples = this->history[name];
+                    samples.push_back(duration_ns / 1e6);
+                    if (samples.size() > HISTORY_FRAMES) {
+                        samples.pop_front();
+                    }
+
+                    this->trace.push_back(TraceEvent{
+                        name, frame_number, begin * this->timestamp_period_ns / 1e3,
+                        duration_ns / 1e3});
+                    if (this->trace.size() > max_trace_events) {
+                        this->trace.pop_front();
+                    }
+                }
+            }
+        }
+
+        if (frame.statistics_written) {
+            u64 values[3];
+            VkResult res = vkGetQueryPoolResults(
+                this->device, frame.statistics_pool, 0, 1, sizeof(values), values,
+                sizeof(values), VK_QUERY_RESULT_64_BIT
+            );
+
+            if (res == VK_SUCCESS) {
+                this->last_pipeline_stats.input_assembly_primitives = values[0];
+                this->last_pipeline_stats.vertex_invocations = values[1];
+                this->last_pipeline_stats.fragment_invocations = values[2];
+            }
+        }
+    }
+} // namespace TANELORN_ENGINE_NAMESPACE
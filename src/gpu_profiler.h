@@ -0,0 +1,111 @@
+#pragma once
+
+#include "defines.h"
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    // Rolling GPU time of one named scope over the last `GpuProfiler::HISTORY_FRAMES` frames.
+    struct GpuScopeStats {
+        std::string name;
+        u32 sample_count;
+        f64 min_ms;
+        f64 average_ms;
+        f64 p99_ms;
+    };
+
+    struct GpuPipelineStats {
+        u64 input_assembly_primitives;
+        u64 vertex_invocations;
+        u64 fragment_invocations;
+    };
+
+    // Timestamp and pipeline statistics queries, one query pool pair per frame in flight.
+    // Results are collected when a slot comes around again, after its fence has signaled, so
+    // reading them never stalls. Scopes are reserved on one thread; the timestamps themselves
+    // may then be written from any thread recording into that frame.
+    class GpuProfiler {
+    public:
+        static constexpr u32 MAX_SCOPES = 256;
+        static constexpr u32 HISTORY_FRAMES = 240;
+        static constexpr u32 INVALID_SCOPE = UINT32_MAX;
+
+        GpuProfiler();
+        ~GpuProfiler();
+
+        GpuProfiler(const GpuProfiler &) = delete;
+        GpuProfiler &operator=(const GpuProfiler &) = delete;
+
+        // `statistics` must only be set when the pipelineStatisticsQuery feature was enabled.
+        void init(
+            VkPhysicalDevice physical_device, VkDevice device, u32 queue_family,
+            u32 frames_in_flight, bool statistics
+        );
+        void destroy();
+
+        // Collects the results last recorded into `slot` and starts a new frame there. The
+        // slot's fence must have signaled.
+        void begin_frame(u32 slot);
+        // Records the query resets for the current frame. Must come before any scope is
+        // written and outside a render pass.
+        void reset_queries(VkCommandBuffer command_buffer);
+
+        // Returns the id of `name`, for scopes reserved every frame without building strings.
+        u32 add_name(const std::string &name);
+        u32 add_scope(const std::string &name);
+        u32 add_scope(u32 name);
+        void write_begin(VkCommandBuffer command_buffer, u32 scope) const;
+        void write_end(VkCommandBuffer command_buffer, u32 scope) const;
+
+        // Pipeline statistics cover everything between the two calls, once per frame.
+        void begin_statistics(VkCommandBuffer command_buffer);
+        void end_statistics(VkCommandBuffer command_buffer);
+        bool statistics_enabled() const;
+        VkQueryPipelineStatisticFlags statistics_flags() const;
+
+        std::vector<GpuScopeStats> scope_stats() const;
+        const GpuPipelineStats &pipeline_stats() const;
+        // Writes the retained scope history in the Chrome trace event format, viewable in
+        // chrome://tracing or Perfetto.
+        bool write_chrome_trace(const std::string &path) const;
+
+    private:
+        struct Frame {
+            VkQueryPool timestamp_pool;
+            VkQueryPool statistics_pool;
+            std::vector<u32> scope_names;
+            bool statistics_written;
+            bool submitted;
+        };
+
+        struct TraceEvent {
+            u32 name;
+            u64 frame;
+            f64 begin_us;
+            f64 duration_us;
+        };
+
+        void collect(Frame &frame);
+
+        VkDevice device;
+        f64 timestamp_period_ns;
+        u64 timestamp_mask;
+        bool statistics;
+        std::vector<Frame> frames;
+        u32 current;
+        u64 frame_number;
+        bool scope_limit_warned;
+
+        std::vector<std::string> names;
+        std::unordered_map<std::string, u32> name_ids;
+        // Per name id, most recent last.
+        std::vector<std::deque<f64>> history;
+        std::deque<TraceEvent> trace;
+        GpuPipelineStats last_pipeline_stats;
+    };
+} // namespace TANELORN_ENGINE_NAMESPACE
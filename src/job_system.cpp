@@ -0,0 +1,111 @@
+#include "job_system.h"
+
+#include <iostream>
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    JobSystem::JobSystem()
+        : job{nullptr}, job_count{0}, next_job{0}, busy_workers{0}, generation{0},
+          stopping{false} {}
+
+    JobSystem::~JobSystem() {
+        this->destroy();
+    }
+
+    void JobSystem::init(u32 worker_count) {
+        this->stopping = false;
+        for (u32 worker = 1; worker < worker_count; worker++) {
+            this->threads.emplace_back(&JobSystem::worker_main, this, worker);
+        }
+
+        std::cout << "Started job system with " << this->worker_count() << " workers."
+                  << std::endl;
+    }
+
+    void JobSystem::destroy() {
+        if (this->threads.empty()) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->start_condition.notify_all();
+
+        for (std::thread &thread : this->threads) {
+            thread.join();
+        }
+        this->threads.clear();
+    }
+
+    void JobSystem::run(u32 job_count, const std::function<void(u32, u32)> &job) {
+        if (job_count == 0) {
+            return;
+        }
+
+        if (this->threads.empty() || job_count == 1) {
+            for (u32 i = 0; i < job_count; i++) {
+                job(i, 0);
+            }
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->job = &job;
+            this->job_count = job_count;
+            this->next_job.store(0, std::memory_order_relaxed);
+            this->busy_workers = static_cast<u32>(this->threads.size());
+            this->generation++;
+        }
+        this->start_condition.notify_all();
+
+        this->execute(0);
+
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->done_condition.wait(lock, [this] { return this->busy_workers == 0; });
+        this->job = nullptr;
+    }
+
+    u32 JobSystem::worker_count() const {
+        return static_cast<u32>(this->threads.size()) + 1;
+    }
+
+    void JobSystem::worker_main(u32 worker) {
+        u64 seen_generation = 0;
+
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->start_condition.wait(lock, [this, seen_generation] {
+                    return this->stopping || this->generation != seen_generation;
+                });
+                if (this->stopping) {
+                    return;
+                }
+                seen_generation = this->generation;
+            }
+
+            this->execute(worker);
+
+            bool last;
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                last = --this->busy_workers == 0;
+            }
+            if (last) {
+                this->done_condition.notify_one();
+            }
+        }
+    }
+
+    void JobSystem::execute(u32 worker) {
+        for (;;) {
+            u32 index = this->next_job.fetch_add(1, std::memory_order_relaxed);
+            if (index >= this->job_count) {
+                return;
+            }
+            (*this->job)(index, worker);
+        }
+    }
+} // namespace TANELORN_ENGINE_NAMESPACE
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "defines.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    // A fixed set of worker threads that run a batch of indexed jobs. The calling thread takes
+    // part as worker 0, so `worker_count` includes it and a count of 1 spawns no threads.
+    class JobSystem {
+    public:
+        JobSystem();
+        ~JobSystem();
+
+        JobSystem(const JobSystem &) = delete;
+        JobSystem &operator=(const JobSystem &) = delete;
+
+        void init(u32 worker_count);
+        void destroy();
+
+        // Calls `job(index, worker)` for every index in [0, job_count) and returns once all of
+        // them have finished. A worker index is only ever used by one thread at a time, so it
+        // can select per-thread state such as a command pool.
+        void run(u32 job_count, const std::function<void(u32, u32)> &job);
+
+        u32 worker_count() const;
+
+    private:
+        void worker_main(u32 worker);
+        void execute(u32 worker);
+
+        std::vector<std::thread> threads;
+        std::mutex mutex;
+        std::condition_variable start_condition;
+        std::condition_variable done_condition;
+
+        const std::function<void(u32, u32)> *job;
+        u32 job_count;
+        std::atomic<u32> next_job;
+        u32 busy_workers;
+        u64 generation;
+        bool stopping;
+    };
+} // namespace TANELORN_ENGINE_NAMESPACE
@@ -1,9 +1,150 @@
 #include "app.h"
+#include "cpu_profiler.h"
 
-int main() {
-    tn::App app{};
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+static void write_ppm(const char *path, VkExtent2D extent, const std::vector<u8> &rgba) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "Could not open the file: " << path << std::endl;
+        return;
+    }
+
+    file << "P6\n" << extent.width << ' ' << extent.height << "\n255\n";
+    for (usize i = 0; i + 3 < rgba.size(); i += 4) {
+        file.write(reinterpret_cast<const char *>(rgba.data() + i), 3);
+    }
+}
+
+static int run_headless(u32 frame_count, const char *output_path) {
+    tn::Renderer renderer{VkExtent2D{800, 600}};
+
+    u32 slot = 0;
+    for (u32 i = 0; i < frame_count; i++) {
+        TN_PROFILE_FRAME();
+        slot = renderer.render_to_image();
+    }
+
+    if (output_path) {
+        std::vector<u8> pixels;
+        renderer.read_image(slot, pixels);
+        write_ppm(output_path, renderer.extent(), pixels);
+    }
+    renderer.wait_idle();
+
+    const tn::FrameStats &stats = renderer.frame_stats();
+    std::cout << "Rendered " << frame_count << " headless frames, avg "
+              << stats.average_frame_ms() << " ms/frame" << std::endl;
+
+    for (const tn::GpuScopeStats &scope : renderer.gpu_profiler().scope_stats()) {
+        std::cout << "GPU " << scope.name << ": min " << scope.min_ms << " ms, avg "
+                  << scope.average_ms << " ms, p99 " << scope.p99_ms << " ms" << std::endl;
+    }
+    if (const char *trace_path = getenv("TN_GPU_TRACE")) {
+        renderer.gpu_profiler().write_chrome_trace(trace_path);
+    }
+#ifndef TN_RELEASE
+    if (const char *trace_path = getenv("TN_CPU_TRACE")) {
+        tn::CpuProfiler::get().write_chrome_trace(trace_path);
+    }
+#endif
+
+    return 0;
+}
+
+// Draws the default triangle with increasing instance counts through the indirect path and
+// reports the frame time for each.
+static int run_instance_bench(u32 frame_count) {
+    tn::Renderer renderer{VkExtent2D{800, 600}};
+    std::mt19937 rng{1234};
+    std::uniform_real_distribution<f32> unit{0.0f, 1.0f};
+
+    for (u32 count : {1000u, 10000u, 100000u, 1000000u}) {
+        renderer.clear_instance_batches();
+
+        std::vector<tn::InstanceData> instances(count);
+        for (tn::InstanceData &instance : instances) {
+            instance.offset[0] = unit(rng) * 2.0f - 1.0f;
+            instance.offset[1] = unit(rng) * 2.0f - 1.0f;
+            instance.scale = 0.01f + unit(rng) * 0.02f;
+            instance.rotation = unit(rng) * 6.2831853f;
+            instance.color[0] = unit(rng);
+            instance.color[1] = unit(rng);
+            instance.color[2] = unit(rng);
+            instance.color[3] = 1.0f;
+        }
+        renderer.create_instance_batch(0, instances);
+
+        // Let the upload land so every timed frame draws the full batch.
+        renderer.render_to_image();
+        renderer.wait_idle();
+        renderer.reset_frame_stats();
+
+        for (u32 i = 0; i < frame_count; i++) {
+            renderer.render_to_image();
+        }
+        renderer.wait_idle();
+
+        const tn::FrameStats &stats = renderer.frame_stats();
+        std::cout << count << " instances: avg " << stats.average_frame_ms() << " ms/frame, max "
+                  << stats.max_frame_ms << " ms" << std::endl;
+    }
+
+    return 0;
+}
+
+static bool parse_present_policy(const char *name, tn::PresentPolicy &policy) {
+    if (strcmp(name, "fifo") == 0) {
+        policy = tn::PresentPolicy::Fifo;
+    } else if (strcmp(name, "fifo-relaxed") == 0) {
+        policy = tn::PresentPolicy::FifoRelaxed;
+    } else if (strcmp(name, "mailbox") == 0) {
+        policy = tn::PresentPolicy::Mailbox;
+    } else if (strcmp(name, "immediate") == 0) {
+        policy = tn::PresentPolicy::Immediate;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+// Usage: vulkan-tutorial [--headless <frames> [output.ppm]] [--instance-bench [frames]]
+//                        [--present fifo|fifo-relaxed|mailbox|immediate] [--fps-limit <fps>]
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "--instance-bench") == 0) {
+        u32 frame_count = argc > 2 ? static_cast<u32>(strtoul(argv[2], nullptr, 10)) : 100;
+
+        return run_instance_bench(frame_count);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--headless") == 0) {
+        u32 frame_count = argc > 2 ? static_cast<u32>(strtoul(argv[2], nullptr, 10)) : 1;
+        const char *output_path = argc > 3 ? argv[3] : nullptr;
+
+        return run_headless(frame_count, output_path);
+    }
+
+    tn::PresentPolicy present_policy = tn::PresentPolicy::Mailbox;
+    f64 frame_limit = 0.0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--present") == 0) {
+            if (!parse_present_policy(argv[i + 1], present_policy)) {
+                std::cout << "Unknown present policy: " << argv[i + 1] << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--fps-limit") == 0) {
+            frame_limit = strtod(argv[i + 1], nullptr);
+        }
+    }
+
+    tn::App app{present_policy, frame_limit};
 
     app.run();
 
     return 0;
-}
\ No newline at end of file
+}
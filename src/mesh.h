@@ -0,0 +1,120 @@
+#pragma once
+
+#include "allocator.h"
+#include "defines.h"
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstddef>
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    struct Vertex {
+        f32 position[2];
+        f32 color[3];
+
+        static VkVertexInputBindingDescription binding_description() {
+            VkVertexInputBindingDescription description{};
+            description.binding = 0;
+            description.stride = sizeof(Vertex);
+            description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+            return description;
+        }
+
+        static std::array<VkVertexInputAttributeDescription, 2> attribute_descriptions() {
+            std::array<VkVertexInputAttributeDescription, 2> descriptions{};
+            descriptions[0].binding = 0;
+            descriptions[0].location = 0;
+            descriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+            descriptions[0].offset = offsetof(Vertex, position);
+
+            descriptions[1].binding = 0;
+            descriptions[1].location = 1;
+            descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+            descriptions[1].offset = offsetof(Vertex, color);
+
+            return descriptions;
+        }
+    };
+
+    // Matches `Instance` in shader.vert (std430).
+    struct InstanceData {
+        f32 offset[2];
+        f32 scale;
+        f32 rotation;
+        f32 color[4];
+    };
+
+    // Matches `FrameConstants` in shader.vert (std430), written once per frame.
+    struct FrameConstants {
+        f32 time;
+        f32 delta_time;
+        f32 extent[2];
+    };
+
+    // Matches `DrawConstants` in shader.vert, pushed before each draw. Buffers are bindless
+    // storage buffer slots.
+    struct DrawConstants {
+        u32 instance_buffer;
+        u32 frame_buffer;
+        u32 frame_constants;
+        // BindlessHeap::INVALID_INDEX when the batch is drawn without culling.
+        u32 culled_draw_buffer;
+    };
+
+    // Matches `Bounds` in cull.comp (std430): the bounding circle of an instance in clip space.
+    struct ObjectBounds {
+        f32 center[2];
+        f32 radius;
+        f32 padding;
+    };
+
+    // Matches `CulledDraw` in cull.comp (std430). The culling dispatches compact a batch's
+    // visible instances into this every frame, in their original order. Their indices follow
+    // it in the buffer, then one visible count per culling workgroup.
+    struct CulledDrawHeader {
+        VkDrawIndexedIndirectCommand command;
+        u32 draw_count;
+    };
+
+    // Many instances of one mesh drawn with a single indirect draw. The indirect commands and
+    // the draw count live in device-local buffers that shaders may rewrite.
+    struct InstanceBatch {
+        u32 mesh;
+        // Pipeline registry id.
+        u32 pipeline;
+        u32 instance_count;
+        VkBuffer instance_buffer;
+        Allocation instance_allocation;
+        VkBuffer indirect_buffer;
+        Allocation indirect_allocation;
+        VkBuffer count_buffer;
+        Allocation count_allocation;
+        u32 max_draw_count;
+        // Slot of instance_buffer in the bindless storage buffer array.
+        u32 instance_buffer_index;
+        // One ObjectBounds per instance, fixed at creation.
+        VkBuffer bounds_buffer;
+        Allocation bounds_allocation;
+        u32 bounds_buffer_index;
+        // Compute buffer the culling dispatches write the batch's CulledDrawHeader and visible
+        // instances into.
+        u32 culled_draws;
+        // GPU profiler name of the batch's draw scope.
+        u32 scope_name;
+        u64 upload_id;
+    };
+
+    struct Mesh {
+        VkBuffer vertex_buffer;
+        Allocation vertex_allocation;
+        VkBuffer index_buffer;
+        Allocation index_allocation;
+        u32 index_count;
+        // Radius of the bounding circle around the model space origin.
+        f32 radius;
+        // Uploader batch that has to complete before the mesh may be drawn.
+        u64 upload_id;
+    };
+} // namespace TANELORN_ENGINE_NAMESPACE
@@ -0,0 +1,165 @@
+#include "pipeline_cache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// Prepended to the Vulkan cache blob, since VkPipelineCacheHeaderVersionOne carries no driver
+// version and drivers are not required to reject data from an older build.
+struct PipelineCacheFileHeader {
+    u32 magic;
+    u32 driver_version;
+    u64 data_size;
+};
+
+constexpr u32 pipeline_cache_magic = 0x434c5054; // "TPLC"
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    PipelineCache::PipelineCache()
+        : device{VK_NULL_HANDLE}, cache{VK_NULL_HANDLE}, properties{}, loaded{false} {}
+
+    PipelineCache::~PipelineCache() {
+        this->destroy();
+    }
+
+    void PipelineCache::create(
+        VkPhysicalDevice physical_device, VkDevice device, const std::string &path
+    ) {
+        this->device = device;
+        this->path = path;
+        vkGetPhysicalDeviceProperties(physical_device, &this->properties);
+
+        std::vector<u8> data;
+        std::ifstream file(path, std::ios::binary);
+        if (file.is_open()) {
+            PipelineCacheFileHeader header{};
+            file.read(reinterpret_cast<char *>(&header), sizeof(header));
+
+            // The size comes from disk, so a truncated or corrupt file must not decide how much
+            // is allocated.
+            std::error_code err;
+            u64 file_size = std::filesystem::file_size(path, err);
+            bool fits = !err && file_size >= sizeof(header)
+                        && header.data_size <= file_size - sizeof(header);
+
+            if (file && fits && header.magic == pipeline_cache_magic
+                && header.driver_version == this->properties.driverVersion) {
+                data.resize(header.data_size);
+                file.read(reinterpret_cast<char *>(data.data()), header.data_size);
+                if (!file || !this->is_compatible(data)) {
+                    data.clear();
+                }
+            }
+        }
+
+        if (data.empty()) {
+            std::cout << "Pipeline cache miss: " << path << std::endl;
+        } else {
+            std::cout << "Pipeline cache hit: " << path << " (" << data.size() << " bytes)"
+                      << std::endl;
+        }
+
+        VkPipelineCacheCreateInfo create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        create_info.initialDataSize = data.size();
+        create_info.pInitialData = data.empty() ? nullptr : data.data();
+
+        VkResult res = vkCreatePipelineCache(this->device, &create_info, nullptr, &this->cache);
+        if (res != VK_SUCCESS && !data.empty()) {
+            // The driver may still refuse data that passed the header checks.
+            create_info.initialDataSize = 0;
+            create_info.pInitialData = nullptr;
+            data.clear();
+            res = vkCreatePipelineCache(this->device, &create_info, nullptr, &this->cache);
+        }
+
+        if (res == VK_SUCCESS) {
+            this->loaded = !data.empty();
+            std::cout << "Successfully created pipeline cache." << std::endl;
+        } else {
+            std::cout << "Failed to create pipeline cache: " << res << std::endl;
+        }
+    }
+
+    void PipelineCache::save() const {
+        if (this->cache == VK_NULL_HANDLE) {
+            return;
+        }
+
+        usize data_size = 0;
+        vkGetPipelineCacheData(this->device, this->cache, &data_size, nullptr);
+
+        std::vector<u8> data(data_size);
+        if (vkGetPipelineCacheData(this->device, this->cache, &data_size, data.data())
+            != VK_SUCCESS) {
+            std::cout << "Failed to read pipeline cache data." << std::endl;
+            return;
+        }
+
+        PipelineCacheFileHeader header{};
+        header.magic = pipeline_cache_magic;
+        header.driver_version = this->properties.driverVersion;
+        header.data_size = data_size;
+
+        // Write to a temporary file first so a crash mid-write never leaves a truncated cache.
+        std::string tmp_path = this->path + ".tmp";
+        {
+            std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                std::cout << "Could not open the file: " << tmp_path << std::endl;
+                return;
+            }
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char *>(data.data()), data_size);
+            if (!file) {
+                std::cout << "Failed to write pipeline cache: " << tmp_path << std::endl;
+                return;
+            }
+        }
+
+        std::error_code err;
+        std::filesystem::rename(tmp_path, this->path, err);
+        if (err) {
+            std::cout << "Failed to save pipeline cache: " << err.message() << std::endl;
+            std::filesystem::remove(tmp_path, err);
+        } else {
+            std::cout << "Saved pipeline cache: " << this->path << " (" << data_size << " bytes)"
+                      << std::endl;
+        }
+    }
+
+    void PipelineCache::destroy() {
+        if (this->cache != VK_NULL_HANDLE) {
+            vkDestroyPipelineCache(this->device, this->cache, nullptr);
+            this->cache = VK_NULL_HANDLE;
+            std::cout << "Destroyed pipeline cache.\n";
+        }
+    }
+
+    VkPipelineCache PipelineCache::handle() const {
+        return this->cache;
+    }
+
+    bool PipelineCache::loaded_from_disk() const {
+        return this->loaded;
+    }
+
+    bool PipelineCache::is_compatible(const std::vector<u8> &data) const {
+        if (data.size() < sizeof(VkPipelineCacheHeaderVersionOne)) {
+            return false;
+        }
+
+        VkPipelineCacheHeaderVersionOne header;
+        memcpy(&header, data.data(), sizeof(header));
+
+        return header.headerSize >= sizeof(VkPipelineCacheHeaderVersionOne)
+               && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+               && header.vendorID == this->properties.vendorID
+               && header.deviceID == this->properties.deviceID
+               && memcmp(
+                      header.pipelineCacheUUID, this->properties.pipelineCacheUUID, VK_UUID_SIZE
+                  ) == 0;
+    }
+} // namespace TANELORN_ENGINE_NAMESPACE
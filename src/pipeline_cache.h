@@ -0,0 +1,37 @@
+#pragma once
+
+#include "defines.h"
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    // On-disk backed VkPipelineCache. Cache data is only reused when it was produced by the same
+    // vendor, device, pipeline cache UUID and driver version as the current physical device.
+    class PipelineCache {
+    public:
+        PipelineCache();
+        ~PipelineCache();
+
+        PipelineCache(const PipelineCache &) = delete;
+        PipelineCache &operator=(const PipelineCache &) = delete;
+
+        void create(VkPhysicalDevice physical_device, VkDevice device, const std::string &path);
+        void save() const;
+        void destroy();
+
+        VkPipelineCache handle() const;
+        bool loaded_from_disk() const;
+
+    private:
+        bool is_compatible(const std::vector<u8> &data) const;
+
+        VkDevice device;
+        VkPipelineCache cache;
+        VkPhysicalDeviceProperties properties;
+        std::string path;
+        bool loaded;
+    };
+} // namespace TANELORN_ENGINE_NAMESPACE
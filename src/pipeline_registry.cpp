@@ -0,0 +1,366 @@
+#include "pipeline_registry.h"
+#include "mesh.h"
+
+#include <chrono>
+#include <iostream>
+
+static void hash_combine(usize &seed, u64 value) {
+    seed ^= static_cast<usize>(value) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    PipelineDesc PipelineDesc::defaults() {
+        PipelineDesc desc{};
+        desc.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        desc.polygon_mode = VK_POLYGON_MODE_FILL;
+        desc.cull_mode = VK_CULL_MODE_BACK_BIT;
+        desc.blend = BlendMode::Opaque;
+        desc.features = SHADER_FEATURES_ALL;
+        return desc;
+    }
+
+    bool PipelineDesc::operator==(const PipelineDesc &other) const {
+        return this->topology == other.topology && this->polygon_mode == other.polygon_mode
+               && this->cull_mode == other.cull_mode && this->blend == other.blend
+               && this->features == other.features;
+    }
+
+    usize PipelineDescHash::operator()(const PipelineDesc &desc) const {
+        usize seed = 0;
+        hash_combine(seed, desc.topology);
+        hash_combine(seed, desc.polygon_mode);
+        hash_combine(seed, desc.cull_mode);
+        hash_combine(seed, static_cast<u64>(desc.blend));
+        hash_combine(seed, desc.features);
+        return seed;
+    }
+
+    PipelineRegistry::PipelineRegistry()
+        : device{VK_NULL_HANDLE}, cache{nullptr}, target{}, shaders{}, pending{false},
+          registry_stats{} {}
+
+    PipelineRegistry::~PipelineRegistry() {
+        this->destroy();
+    }
+
+    void PipelineRegistry::init(
+        VkDevice device, const PipelineCache &cache, const PipelineTarget &target
+    ) {
+        this->device = device;
+        this->cache = &cache;
+        this->target = target;
+    }
+
+    void PipelineRegistry::destroy() {
+        if (this->device == VK_NULL_HANDLE) {
+            return;
+        }
+
+        for (VkPipeline pipeline : this->pipelines) {
+            vkDestroyPipeline(this->device, pipeline, nullptr);
+        }
+        this->pipelines.clear();
+        this->descs.clear();
+        this->ids.clear();
+        this->destroy_shaders(this->shaders);
+        this->device = VK_NULL_HANDLE;
+
+        std::cout << "Destroyed pipelines.\n";
+    }
+
+    PipelineShaders
+    PipelineRegistry::create_shaders(const SpirvCode &vertex, const SpirvCode &fragment) const {
+        PipelineShaders shaders{};
+        const SpirvCode *code[2] = {&vertex, &fragment};
+        VkShaderModule *modules[2] = {&shaders.vertex, &shaders.fragment};
+
+        for (u32 i = 0; i < 2; i++) {
+            VkShaderModuleCreateInfo create_info{};
+            create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+            create_info.codeSize = code[i]->size();
+            create_info.pCode = code[i]->words();
+
+            VkResult res = vkCreateShaderModule(this->device, &create_info, nullptr, modules[i]);
+            if (res == VK_SUCCESS) {
+                std::cout << "Successfully created shader module." << std::endl;
+            } else {
+                std::cout << "Failed to create shader module: " << res << '.' << std::endl;
+                *modules[i] = VK_NULL_HANDLE;
+            }
+        }
+
+        return shaders;
+    }
+
+    void PipelineRegistry::destroy_shaders(PipelineShaders &shaders) const {
+        vkDestroyShaderModule(this->device, shaders.vertex, nullptr);
+        vkDestroyShaderModule(this->device, shaders.fragment, nullptr);
+        shaders = PipelineShaders{};
+    }
+
+    void PipelineRegistry::set_shaders(const PipelineShaders &shaders) {
+        this->destroy_shaders(this->shaders);
+        this->shaders = shaders;
+    }
+
+    u32 PipelineRegistry::request(const PipelineDesc &desc) {
+        std::lock_guard<std::mutex> lock(this->descs_mutex);
+        this->registry_stats.requests++;
+
+        auto it = this->ids.find(desc);
+        if (it != this->ids.end()) {
+            this->registry_stats.deduplicated++;
+            return it->second;
+        }
+
+        u32 id = static_cast<u32>(this->descs.size());
+        this->descs.push_back(desc);
+        this->ids.emplace(desc, id);
+        this->pipelines.push_back(VK_NULL_HANDLE);
+        this->pending = true;
+        this->registry_stats.variants = static_cast<u32>(this->descs.size());
+        return id;
+    }
+
+    void PipelineRegistry::build_pending(JobSystem &jobs) {
+        if (!this->pending) {
+            return;
+        }
+        this->pending = false;
+
+        // Only this thread appends to `descs`, so they can be read without the lock here.
+        std::vector<u32> missing;
+        for (u32 id = 0; id < this->pipelines.size(); id++) {
+            if (this->pipelines[id] == VK_NULL_HANDLE) {
+                missing.push_back(id);
+            }
+        }
+
+        // VkPipelineCache is internally synchronized, so every worker can share it.
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        jobs.run(static_cast<u32>(missing.size()), [&](u32 index, u32) {
+            u32 id = missing[index];
+            this->pipelines[id] = this->build(this->descs[id], this->shaders);
+        });
+        std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+
+        this->registry_stats.last_build_count = static_cast<u32>(missing.size());
+        this->registry_stats.last_build_ms =
+            std::chrono::duration<f64, std::milli>(elapsed).count();
+
+        std::cout << "Successfully created " << missing.size() << " pipelines in "
+                  << this->registry_stats.last_build_ms << " ms on " << jobs.worker_count()
+                  << " workers (pipeline cache "
+                  << (this->cache->loaded_from_disk() ? "hit" : "miss") << ")." << std::endl;
+    }
+
+    bool PipelineRegistry::has_pending() const {
+        return this->pending;
+    }
+
+    VkPipeline PipelineRegistry::pipeline(u32 id) const {
+        return this->pipelines[id];
+    }
+
+    bool PipelineRegistry::build_set(PipelineSet &set) const {
+        std::vector<PipelineDesc> descs;
+        {
+            std::lock_guard<std::mutex> lock(this->descs_mutex);
+            descs = this->descs;
+        }
+
+        set.pipelines.clear();
+        if (set.shaders.vertex == VK_NULL_HANDLE || set.shaders.fragment == VK_NULL_HANDLE) {
+            return false;
+        }
+
+        for (const PipelineDesc &desc : descs) {
+            VkPipeline pipeline = this->build(desc, set.shaders);
+            if (pipeline == VK_NULL_HANDLE) {
+                for (VkPipeline built : set.pipelines) {
+                    vkDestroyPipeline(this->device, built, nullptr);
+                }
+                set.pipelines.clear();
+                return false;
+            }
+            set.pipelines.push_back(pipeline);
+        }
+
+        return true;
+    }
+
+    void PipelineRegistry::swap_set(PipelineSet &set, std::vector<VkPipeline> &retired) {
+        for (u32 id = 0; id < this->pipelines.size(); id++) {
+            if (this->pipelines[id] != VK_NULL_HANDLE) {
+                retired.push_back(this->pipelines[id]);
+            }
+            this->pipelines[id] = id < set.pipelines.size() ? set.pipelines[id] : VK_NULL_HANDLE;
+        }
+        this->pending = set.pipelines.size() < this->pipelines.size();
+
+        // Pipelines do not reference their modules after creation, so the old ones can go.
+        this->set_shaders(set.shaders);
+        set = PipelineSet{};
+    }
+
+    void PipelineRegistry::destroy_set(PipelineSet &set) const {
+        for (VkPipeline pipeline : set.pipelines) {
+            vkDestroyPipeline(this->device, pipeline, nullptr);
+        }
+        PipelineShaders shaders = set.shaders;
+        this->destroy_shaders(shaders);
+        set = PipelineSet{};
+    }
+
+    const PipelineRegistryStats &PipelineRegistry::stats() const {
+        return this->registry_stats;
+    }
+
+    VkPipeline
+    PipelineRegistry::build(const PipelineDesc &desc, const PipelineShaders &shaders) const {
+        VkSpecializationMapEntry feature_entry{};
+        feature_entry.constantID = 0;
+        feature_entry.offset = 0;
+        feature_entry.size = sizeof(desc.features);
+
+        VkSpecializationInfo specialization{};
+        specialization.mapEntryCount = 1;
+        specialization.pMapEntries = &feature_entry;
+        specialization.dataSize = sizeof(desc.features);
+        specialization.pData = &desc.features;
+
+        VkPipelineShaderStageCreateInfo shader_stages[2]{};
+        shader_stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shader_stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        shader_stages[0].module = shaders.vertex;
+        shader_stages[0].pName = "main";
+        shader_stages[0].pSpecializationInfo = &specialization;
+        shader_stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shader_stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        shader_stages[1].module = shaders.fragment;
+        shader_stages[1].pName = "main";
+        shader_stages[1].pSpecializationInfo = &specialization;
+
+        VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
+        VkPipelineDynamicStateCreateInfo dynamic_state{};
+        dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamic_state.dynamicStateCount = 2;
+        dynamic_state.pDynamicStates = dynamic_states;
+
+        VkVertexInputBindingDescription binding_description = Vertex::binding_description();
+        std::array<VkVertexInputAttributeDescription, 2> attribute_descriptions =
+            Vertex::attribute_descriptions();
+
+        VkPipelineVertexInputStateCreateInfo vertex_input_state{};
+        vertex_input_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vertex_input_state.vertexBindingDescriptionCount = 1;
+        vertex_input_state.pVertexBindingDescriptions = &binding_description;
+        vertex_input_state.vertexAttributeDescriptionCount =
+            static_cast<uint32_t>(attribute_descriptions.size());
+        vertex_input_state.pVertexAttributeDescriptions = attribute_descriptions.data();
+
+        VkPipelineInputAssemblyStateCreateInfo input_assembly{};
+        input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        input_assembly.topology = desc.topology;
+        input_assembly.primitiveRestartEnable = VK_FALSE;
+
+        VkPipelineViewportStateCreateInfo viewport_state{};
+        viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewport_state.viewportCount = 1;
+        viewport_state.scissorCount = 1;
+
+        VkPipelineRasterizationStateCreateInfo rasterizer{};
+        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rasterizer.depthClampEnable = VK_FALSE;
+        rasterizer.rasterizerDiscardEnable = VK_FALSE;
+        rasterizer.polygonMode = desc.polygon_mode;
+        rasterizer.lineWidth = 1.0f;
+        rasterizer.cullMode = desc.cull_mode;
+        rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+        rasterizer.depthBiasEnable = VK_FALSE;
+
+        VkPipelineMultisampleStateCreateInfo multisampling{};
+        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisampling.sampleShadingEnable = VK_FALSE;
+        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        multisampling.minSampleShading = 1.0f;
+        multisampling.alphaToCoverageEnable = VK_FALSE;
+        multisampling.alphaToOneEnable = VK_FALSE;
+
+        VkPipelineColorBlendAttachmentState color_blend_attachment{};
+        color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
+                                                | VK_COLOR_COMPONENT_B_BIT
+                                                | VK_COLOR_COMPONENT_A_BIT;
+        color_blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
+        color_blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+        switch (desc.blend) {
+            case BlendMode::Opaque:
+                color_blend_attachment.blendEnable = VK_FALSE;
+                color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+                color_blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+                color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+                color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+                break;
+            case BlendMode::Alpha:
+                color_blend_attachment.blendEnable = VK_TRUE;
+                color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+                color_blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+                color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+                color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+                break;
+            case BlendMode::Additive:
+                color_blend_attachment.blendEnable = VK_TRUE;
+                color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+                color_blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+                color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+                color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+                break;
+        }
+
+        VkPipelineColorBlendStateCreateInfo color_blending{};
+        color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        color_blending.logicOpEnable = VK_FALSE;
+        color_blending.logicOp = VK_LOGIC_OP_COPY;
+        color_blending.attachmentCount = 1;
+        color_blending.pAttachments = &color_blend_attachment;
+
+        VkGraphicsPipelineCreateInfo create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        create_info.stageCount = 2;
+        create_info.pStages = shader_stages;
+        create_info.pVertexInputState = &vertex_input_state;
+        create_info.pInputAssemblyState = &input_assembly;
+        create_info.pViewportState = &viewport_state;
+        create_info.pRasterizationState = &rasterizer;
+        create_info.pMultisampleState = &multisampling;
+        create_info.pColorBlendState = &color_blending;
+        create_info.pDynamicState = &dynamic_state;
+        create_info.layout = this->target.layout;
+        create_info.renderPass = this->target.render_pass;
+        create_info.subpass = 0;
+        create_info.basePipelineHandle = VK_NULL_HANDLE;
+        create_info.basePipelineIndex = -1;
+
+        // Without a render pass the pipeline only depends on the attachment formats, so it
+        // stays valid for any target with the same format.
+        VkPipelineRenderingCreateInfoKHR rendering_info{};
+        rendering_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+        rendering_info.colorAttachmentCount = 1;
+        rendering_info.pColorAttachmentFormats = &this->target.color_format;
+        if (this->target.render_pass == VK_NULL_HANDLE) {
+            create_info.pNext = &rendering_info;
+        }
+
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        VkResult res = vkCreateGraphicsPipelines(
+            this->device, this->cache->handle(), 1, &create_info, nullptr, &pipeline
+        );
+        if (res != VK_SUCCESS) {
+            std::cout << "Failed to create pipeline: " << res << '.' << std::endl;
+            pipeline = VK_NULL_HANDLE;
+        }
+
+        return pipeline;
+    }
+} // namespace TANELORN_ENGINE_NAMESPACE
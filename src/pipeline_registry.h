@@ -0,0 +1,130 @@
+#pragma once
+
+#include "defines.h"
+#include "job_system.h"
+#include "pipeline_cache.h"
+#include "shader_manager.h"
+
+#include <vulkan/vulkan.h>
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    // Bits of the `FEATURES` specialization constant (constant_id 0) in shader.vert.
+    constexpr u32 SHADER_FEATURE_VERTEX_COLOR = 1u << 0;
+    constexpr u32 SHADER_FEATURE_INSTANCE_COLOR = 1u << 1;
+    constexpr u32 SHADER_FEATURES_ALL = SHADER_FEATURE_VERTEX_COLOR | SHADER_FEATURE_INSTANCE_COLOR;
+
+    enum class BlendMode {
+        Opaque,
+        // Blends by the instance color's alpha.
+        Alpha,
+        Additive,
+    };
+
+    // The state that differs between pipeline variants. Everything else (layout, vertex format,
+    // attachments, dynamic viewport and scissor) is shared by every variant.
+    struct PipelineDesc {
+        VkPrimitiveTopology topology;
+        VkPolygonMode polygon_mode;
+        VkCullModeFlags cull_mode;
+        BlendMode blend;
+        // SHADER_FEATURE_* bits, compiled in through specialization constants.
+        u32 features;
+
+        static PipelineDesc defaults();
+
+        bool operator==(const PipelineDesc &other) const;
+    };
+
+    struct PipelineDescHash {
+        usize operator()(const PipelineDesc &desc) const;
+    };
+
+    // What the pipelines render into.
+    struct PipelineTarget {
+        VkPipelineLayout layout;
+        // VK_NULL_HANDLE with dynamic rendering, in which case only the format is used.
+        VkRenderPass render_pass;
+        VkFormat color_format;
+    };
+
+    struct PipelineShaders {
+        VkShaderModule vertex;
+        VkShaderModule fragment;
+    };
+
+    // Every registered variant built against new shaders, waiting to be swapped in.
+    struct PipelineSet {
+        PipelineShaders shaders;
+        std::vector<VkPipeline> pipelines;
+    };
+
+    struct PipelineRegistryStats {
+        u32 variants;
+        u32 requests;
+        // Requests answered with an existing variant.
+        u32 deduplicated;
+        u32 last_build_count;
+        f64 last_build_ms;
+    };
+
+    // Owns every graphics pipeline variant. Variants are requested by description and identical
+    // descriptions share one pipeline. Requested variants are built together, in parallel on
+    // the job system's workers, so a known list can be prewarmed at startup in one go. All
+    // variants share one pair of shader modules; feature permutations are selected through
+    // specialization constants rather than separate SPIR-V.
+    class PipelineRegistry {
+    public:
+        PipelineRegistry();
+        ~PipelineRegistry();
+
+        PipelineRegistry(const PipelineRegistry &) = delete;
+        PipelineRegistry &operator=(const PipelineRegistry &) = delete;
+
+        void init(VkDevice device, const PipelineCache &cache, const PipelineTarget &target);
+        void destroy();
+
+        // Modules that failed to create are VK_NULL_HANDLE.
+        PipelineShaders create_shaders(const SpirvCode &vertex, const SpirvCode &fragment) const;
+        void destroy_shaders(PipelineShaders &shaders) const;
+        // Takes ownership of `shaders` for every variant built from now on.
+        void set_shaders(const PipelineShaders &shaders);
+
+        // Returns the id of the variant matching `desc`, registering it on first use. The
+        // pipeline is created by the next `build_pending`.
+        u32 request(const PipelineDesc &desc);
+        // Creates every registered variant that has no pipeline yet.
+        void build_pending(JobSystem &jobs);
+        bool has_pending() const;
+        VkPipeline pipeline(u32 id) const;
+
+        // Thread safe. Builds every variant registered so far against `set.shaders`, on the
+        // calling thread. On failure nothing is kept and false is returned.
+        bool build_set(PipelineSet &set) const;
+        // Installs a set from `build_set`, appending the pipelines it replaces to `retired`.
+        // Variants registered while the set was being built are rebuilt by `build_pending`.
+        void swap_set(PipelineSet &set, std::vector<VkPipeline> &retired);
+        void destroy_set(PipelineSet &set) const;
+
+        const PipelineRegistryStats &stats() const;
+
+    private:
+        VkPipeline build(const PipelineDesc &desc, const PipelineShaders &shaders) const;
+
+        VkDevice device;
+        const PipelineCache *cache;
+        PipelineTarget target;
+        PipelineShaders shaders;
+        // Guards `descs` and `ids`, which `build_set` reads from the shader watcher thread.
+        mutable std::mutex descs_mutex;
+        std::vector<PipelineDesc> descs;
+        std::unordered_map<PipelineDesc, u32, PipelineDescHash> ids;
+        // Indexed by id; VK_NULL_HANDLE until built.
+        std::vector<VkPipeline> pipelines;
+        bool pending;
+        PipelineRegistryStats registry_stats;
+    };
+} // namespace TANELORN_ENGINE_NAMESPACE
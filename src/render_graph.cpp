@@ -0,0 +1,720 @@
+#include "render_graph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+struct AccessInfo {
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    VkImageLayout layout;
+};
+
+static AccessInfo access_info(tn::ResourceAccess access) {
+    switch (access) {
+        case tn::ResourceAccess::ColorAttachmentWrite:
+            return AccessInfo{
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+        case tn::ResourceAccess::DepthAttachmentWrite:
+            return AccessInfo{
+                VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT
+                    | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT
+                    | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+        case tn::ResourceAccess::VertexShaderRead:
+            return AccessInfo{
+                VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        case tn::ResourceAccess::FragmentShaderRead:
+            return AccessInfo{
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        case tn::ResourceAccess::ComputeShaderRead:
+            return AccessInfo{
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        case tn::ResourceAccess::ComputeShaderWrite:
+            return AccessInfo{
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                VK_IMAGE_LAYOUT_GENERAL};
+        case tn::ResourceAccess::IndirectCommandRead:
+            return AccessInfo{
+                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+                VK_IMAGE_LAYOUT_UNDEFINED};
+        case tn::ResourceAccess::TransferRead:
+            return AccessInfo{
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL};
+        case tn::ResourceAccess::TransferWrite:
+            return AccessInfo{
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL};
+    }
+
+    return AccessInfo{VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, VK_IMAGE_LAYOUT_GENERAL};
+}
+
+static const char *layout_name(VkImageLayout layout) {
+    switch (layout) {
+        case VK_IMAGE_LAYOUT_UNDEFINED:
+            return "undefined";
+        case VK_IMAGE_LAYOUT_GENERAL:
+            return "general";
+        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+            return "color attachment";
+        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+            return "depth attachment";
+        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+            return "shader read";
+        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+            return "transfer src";
+        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+            return "transfer dst";
+        case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+            return "present";
+        default:
+            return "other";
+    }
+}
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    RenderGraph::RenderGraph()
+        : device{VK_NULL_HANDLE}, allocator{nullptr}, pipeline_barrier2{nullptr}, graph_stats{} {}
+
+    RenderGraph::~RenderGraph() {
+        this->destroy();
+    }
+
+    void RenderGraph::init(
+        VkDevice device, GpuAllocator &allocator, PFN_vkCmdPipelineBarrier2KHR pipeline_barrier2
+    ) {
+        this->device = device;
+        this->allocator = &allocator;
+        this->pipeline_barrier2 = pipeline_barrier2;
+    }
+
+    void RenderGraph::destroy() {
+        if (this->device == VK_NULL_HANDLE) {
+            return;
+        }
+
+        this->reset();
+        this->device = VK_NULL_HANDLE;
+
+        std::cout << "Destroyed render graph.\n";
+    }
+
+    void RenderGraph::reset() {
+        this->destroy_transient_images();
+        this->resources.clear();
+        this->passes.clear();
+        this->compiled.clear();
+        this->graph_stats = RenderGraphStats{};
+    }
+
+    GraphResource RenderGraph::import_image(
+        const std::string &name, VkImageAspectFlags aspect, const ResourceState &initial
+    ) {
+        Resource resource{};
+        resource.name = name;
+        resource.is_image = true;
+        resource.aspect = aspect;
+        resource.initial = initial;
+        this->resources.push_back(resource);
+
+        return static_cast<GraphResource>(this->resources.size() - 1);
+    }
+
+    GraphResource
+    RenderGraph::import_buffer(const std::string &name, const ResourceState &initial) {
+        Resource resource{};
+        resource.name = name;
+        resource.initial = initial;
+        this->resources.push_back(resource);
+
+        return static_cast<GraphResource>(this->resources.size() - 1);
+    }
+
+    GraphResource
+    RenderGraph::create_image(const std::string &name, const TransientImageDesc &desc) {
+        Resource resource{};
+        resource.name = name;
+        resource.is_image = true;
+        resource.transient = true;
+        resource.aspect = desc.aspect;
+        resource.desc = desc;
+        resource.initial = ResourceState{0, 0, VK_IMAGE_LAYOUT_UNDEFINED};
+        this->resources.push_back(resource);
+
+        return static_cast<GraphResource>(this->resources.size() - 1);
+    }
+
+    void RenderGraph::export_resource(
+        GraphResource resource, const ResourceState &final_state, u32 src_family, u32 dst_family
+    ) {
+        Resource &exported = this->resources[resource];
+        exported.exported = true;
+        exported.final_state = final_state;
+        exported.release_src_family = src_family;
+        exported.release_dst_family = dst_family;
+    }
+
+    u32 RenderGraph::add_pass(const std::string &name, PassCallback record) {
+        this->passes.push_back(Pass{name, std::move(record), {}, false});
+
+        return static_cast<u32>(this->passes.size() - 1);
+    }
+
+    void RenderGraph::read(u32 pass, GraphResource resource, ResourceAccess access) {
+        this->passes[pass].accesses.push_back(PassAccess{resource, access, false});
+    }
+
+    void RenderGraph::write(u32 pass, GraphResource resource, ResourceAccess access) {
+        this->passes[pass].accesses.push_back(PassAccess{resource, access, true});
+    }
+
+    void RenderGraph::compile() {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        this->destroy_transient_images();
+        this->compiled.clear();
+        this->graph_stats = RenderGraphStats{};
+
+        this->cull_passes();
+        for (u32 i = 0; i < this->passes.size(); i++) {
+            if (!this->passes[i].culled) {
+                this->compiled.push_back(CompiledPass{i, 0, 0, {}});
+            }
+        }
+
+        this->allocate_transient_images();
+        this->schedule_barriers();
+
+        this->graph_stats.declared_passes = static_cast<u32>(this->passes.size());
+        for (const CompiledPass &entry : this->compiled) {
+            this->graph_stats.barriers += static_cast<u32>(entry.barriers.size());
+        }
+        std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+        this->graph_stats.compile_ms = std::chrono::duration<f64, std::milli>(elapsed).count();
+    }
+
+    void RenderGraph::bind_image(GraphResource resource, VkImage image, VkImageView view) {
+        this->resources[resource].image = image;
+        this->resources[resource].view = view;
+    }
+
+    void RenderGraph::bind_buffer(GraphResource resource, VkBuffer buffer) {
+        this->resources[resource].buffer = buffer;
+    }
+
+    VkImage RenderGraph::image(GraphResource resource) const {
+        return this->resources[resource].image;
+    }
+
+    VkImageView RenderGraph::image_view(GraphResource resource) const {
+        return this->resources[resource].view;
+    }
+
+    VkBuffer RenderGraph::buffer(GraphResource resource) const {
+        return this->resources[resource].buffer;
+    }
+
+    void RenderGraph::execute(VkCommandBuffer command_buffer) const {
+        for (const CompiledPass &entry : this->compiled) {
+            if (!entry.barriers.empty()) {
+                if (this->pipeline_barrier2) {
+                    this->record_barriers2(command_buffer, entry);
+                } else {
+                    this->record_barriers(command_buffer, entry);
+                }
+            }
+
+            if (entry.pass != EXIT_PASS) {
+                this->passes[entry.pass].record(command_buffer);
+            }
+        }
+    }
+
+    const std::vector<CompiledPass> &RenderGraph::schedule() const {
+        return this->compiled;
+    }
+
+    const std::string &RenderGraph::pass_name(u32 pass) const {
+        return this->passes[pass].name;
+    }
+
+    const std::string &RenderGraph::resource_name(GraphResource resource) const {
+        return this->resources[resource].name;
+    }
+
+    const RenderGraphStats &RenderGraph::stats() const {
+        return this->graph_stats;
+    }
+
+    bool RenderGraph::has_transient_images() const {
+        return !this->memory_slots.empty();
+    }
+
+    void RenderGraph::print_schedule() const {
+        const RenderGraphStats &stats = this->graph_stats;
+        std::cout << "Render graph: " << stats.declared_passes - stats.culled_passes << " passes ("
+                  << stats.culled_passes << " culled), " << stats.barriers << " barriers, "
+                  << stats.transient_images << " transient images in " << stats.transient_bytes
+                  << " bytes (" << stats.unaliased_bytes << " without aliasing), compiled in "
+                  << stats.compile_ms << " ms.\n";
+
+        for (const CompiledPass &entry : this->compiled) {
+            std::cout << "  "
+                      << (entry.pass != EXIT_PASS ? this->passes[entry.pass].name : "exit")
+                      << '\n';
+            for (const GraphBarrier &barrier : entry.barriers) {
+                const Resource &resource = this->resources[barrier.resource];
+                std::cout << "    barrier " << resource.name;
+                if (resource.is_image && barrier.src.layout != barrier.dst.layout) {
+                    std::cout << ": " << layout_name(barrier.src.layout) << " -> "
+                              << layout_name(barrier.dst.layout);
+                }
+                if (entry.pass == EXIT_PASS
+                    && resource.release_src_family != resource.release_dst_family) {
+                    std::cout << ", released to queue family " << resource.release_dst_family;
+                }
+                std::cout << '\n';
+            }
+        }
+        std::cout << std::flush;
+    }
+
+    void RenderGraph::cull_passes() {
+        // Walk backwards from the exported resources, keeping every pass that writes something
+        // a kept pass or the frame's result depends on.
+        std::vector<bool> needed(this->resources.size(), false);
+        for (usize i = 0; i < this->resources.size(); i++) {
+            needed[i] = this->resources[i].exported;
+        }
+
+        for (usize i = this->passes.size(); i-- > 0;) {
+            Pass &pass = this->passes[i];
+
+            pass.culled = true;
+            for (const PassAccess &access : pass.accesses) {
+                if (access.write && needed[access.resource]) {
+                    pass.culled = false;
+                }
+            }
+
+            if (pass.culled) {
+                this->graph_stats.culled_passes++;
+                continue;
+            }
+            for (const PassAccess &access : pass.accesses) {
+                if (!access.write) {
+                    needed[access.resource] = true;
+                }
+            }
+        }
+    }
+
+    void RenderGraph::allocate_transient_images() {
+        for (Resource &resource : this->resources) {
+            resource.first_use = UINT32_MAX;
+            resource.last_use = 0;
+        }
+        for (u32 i = 0; i < this->compiled.size(); i++) {
+            for (const PassAccess &access : this->passes[this->compiled[i].pass].accesses) {
+                Resource &resource = this->resources[access.resource];
+                resource.first_use = std::min(resource.first_use, i);
+                resource.last_use = std::max(resource.last_use, i);
+            }
+        }
+
+        std::vector<GraphResource> transients;
+        std::vector<VkMemoryRequirements> requirements(this->resources.size());
+        for (GraphResource i = 0; i < this->resources.size(); i++) {
+            Resource &resource = this->resources[i];
+            if (!resource.transient || resource.first_use == UINT32_MAX) {
+                continue;
+            }
+
+            VkImageCreateInfo image_info{};
+            image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            image_info.imageType = VK_IMAGE_TYPE_2D;
+            image_info.format = resource.desc.format;
+            image_info.extent = {resource.desc.extent.width, resource.desc.extent.height, 1};
+            image_info.mipLevels = 1;
+            image_info.arrayLayers = 1;
+            image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+            image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+            image_info.usage = resource.desc.usage;
+            image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            if (vkCreateImage(this->device, &image_info, nullptr, &resource.image) != VK_SUCCESS) {
+                std::cout << "Failed to create transient image " << resource.name << '.'
+                          << std::endl;
+                continue;
+            }
+            vkGetImageMemoryRequirements(this->device, resource.image, &requirements[i]);
+            this->graph_stats.unaliased_bytes += requirements[i].size;
+            transients.push_back(i);
+        }
+
+        // Largest first, each into the first slot whose occupants are all dead by the time it
+        // is first used and whose memory types it can live in.
+        std::sort(transients.begin(), transients.end(), [&](GraphResource a, GraphResource b) {
+            return requirements[a].size > requirements[b].size;
+        });
+
+        for (GraphResource i : transients) {
+            Resource &resource = this->resources[i];
+            const VkMemoryRequirements &image_requirements = requirements[i];
+
+            u32 slot_index = static_cast<u32>(this->memory_slots.size());
+            for (u32 s = 0; s < this->memory_slots.size(); s++) {
+                const MemorySlot &slot = this->memory_slots[s];
+                bool overlaps = false;
+                for (const std::pair<u32, u32> &lifetime : slot.lifetimes) {
+                    overlaps |= resource.first_use <= lifetime.second
+                                && lifetime.first <= resource.last_use;
+                }
+                if (!overlaps
+                    && (slot.requirements.memoryTypeBits & image_requirements.memoryTypeBits)) {
+                    slot_index = s;
+                    break;
+                }
+            }
+
+            if (slot_index == this->memory_slots.size()) {
+                this->memory_slots.push_back(MemorySlot{image_requirements, {}, {}});
+            }
+
+            MemorySlot &slot = this->memory_slots[slot_index];
+            slot.requirements.size = std::max(slot.requirements.size, image_requirements.size);
+            slot.requirements.alignment =
+                std::max(slot.requirements.alignment, image_requirements.alignment);
+            slot.requirements.memoryTypeBits &= image_requirements.memoryTypeBits;
+            slot.lifetimes.push_back({resource.first_use, resource.last_use});
+            resource.memory_slot = slot_index;
+        }
+
+        for (MemorySlot &slot : this->memory_slots) {
+            if (!this->allocator->allocate(
+                    slot.requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ResourceKind::Optimal,
+                    slot.allocation
+                )) {
+                std::cout << "Failed to allocate transient image memory." << std::endl;
+            }
+            this->graph_stats.transient_bytes += slot.requirements.size;
+        }
+
+        for (GraphResource i : transients) {
+            Resource &resource = this->resources[i];
+            const Allocation &allocation = this->memory_slots[resource.memory_slot].allocation;
+            vkBindImageMemory(this->device, resource.image, allocation.memory, allocation.offset);
+
+            VkImageViewCreateInfo view_info{};
+            view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            view_info.image = resource.image;
+            view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            view_info.format = resource.desc.format;
+            view_info.subresourceRange.aspectMask = resource.desc.aspect;
+            view_info.subresourceRange.baseMipLevel = 0;
+            view_info.subresourceRange.levelCount = 1;
+            view_info.subresourceRange.baseArrayLayer = 0;
+            view_info.subresourceRange.layerCount = 1;
+            vkCreateImageView(this->device, &view_info, nullptr, &resource.view);
+        }
+
+        this->graph_stats.transient_images = static_cast<u32>(transients.size());
+    }
+
+    void RenderGraph::schedule_barriers() {
+        // Per resource: the current layout, the last write not yet followed by a barrier,
+        // the stages that have read since, and which stages already see that write.
+        struct Tracker {
+            VkImageLayout layout;
+            VkPipelineStageFlags write_stages;
+            VkAccessFlags write_access;
+            VkPipelineStageFlags read_stages;
+            VkPipelineStageFlags visible_stages;
+            // Where the first barrier of a transient image went, to fill in its source later.
+            u32 entry_pass;
+            u32 entry_barrier;
+        };
+
+        std::vector<Tracker> trackers(this->resources.size());
+        for (usize i = 0; i < this->resources.size(); i++) {
+            const ResourceState &initial = this->resources[i].initial;
+            trackers[i] = Tracker{
+                initial.layout, initial.stages, initial.access, 0, 0, UINT32_MAX, UINT32_MAX};
+        }
+
+        struct Usage {
+            GraphResource resource;
+            AccessInfo info;
+            bool write;
+        };
+        std::vector<Usage> usages;
+
+        for (u32 p = 0; p < this->compiled.size(); p++) {
+            CompiledPass &entry = this->compiled[p];
+
+            // A resource used several ways by one pass is synchronized once for all of them.
+            usages.clear();
+            for (const PassAccess &access : this->passes[entry.pass].accesses) {
+                AccessInfo info = access_info(access.access);
+                std::vector<Usage>::iterator usage =
+                    std::find_if(usages.begin(), usages.end(), [&](const Usage &u) {
+                        return u.resource == access.resource;
+                    });
+                if (usage == usages.end()) {
+                    usages.push_back(Usage{access.resource, info, access.write});
+                } else {
+                    usage->info.stages |= info.stages;
+                    usage->info.access |= info.access;
+                    if (access.write) {
+                        usage->info.layout = info.layout;
+                        usage->write = true;
+                    }
+                }
+            }
+
+            for (const Usage &usage : usages) {
+                const Resource &resource = this->resources[usage.resource];
+                Tracker &tracker = trackers[usage.resource];
+
+                bool layout_change = resource.is_image && tracker.layout != usage.info.layout;
+                ResourceState src{0, 0, tracker.layout};
+                bool needs_barrier = false;
+
+                if (layout_change || usage.write) {
+                    // Everything since the last barrier has to finish first.
+                    src.stages = tracker.write_stages | tracker.read_stages;
+                    src.access = tracker.write_access;
+                    needs_barrier = layout_change || src.stages != 0;
+                } else if (tracker.write_stages != 0
+                           && (usage.info.stages & ~tracker.visible_stages) != 0) {
+                    src.stages = tracker.write_stages;
+                    src.access = tracker.write_access;
+                    needs_barrier = true;
+                }
+
+                if (needs_barrier) {
+                    ResourceState dst{
+                        usage.info.stages, usage.info.access,
+                        resource.is_image ? usage.info.layout : VK_IMAGE_LAYOUT_UNDEFINED};
+                    if (resource.transient && tracker.entry_pass == UINT32_MAX) {
+                        tracker.entry_pass = p;
+                        tracker.entry_barrier = static_cast<u32>(entry.barriers.size());
+                    }
+                    entry.barriers.push_back(GraphBarrier{usage.resource, src, dst});
+                    entry.src_stages |= src.stages;
+                    entry.dst_stages |= dst.stages;
+                }
+
+                if (usage.write || layout_change) {
+                    // A layout transition is a write too; later reads in other stages have to
+                    // be ordered after it.
+                    tracker.write_stages = usage.info.stages;
+                    tracker.write_access = usage.write ? usage.info.access : 0;
+                    tracker.read_stages = 0;
+                    tracker.visible_stages = usage.write ? 0 : usage.info.stages;
+                } else {
+                    tracker.read_stages |= usage.info.stages;
+                    if (needs_barrier) {
+                        tracker.visible_stages |= usage.info.stages;
+                    }
+                }
+                tracker.layout = resource.is_image ? usage.info.layout : tracker.layout;
+            }
+        }
+
+        // A transient image takes over its memory from whichever image last used it, possibly
+        // in the previous frame, so its first barrier waits on that image's last use.
+        for (GraphResource i = 0; i < this->resources.size(); i++) {
+            const Resource &resource = this->resources[i];
+            if (!resource.transient || trackers[i].entry_pass == UINT32_MAX) {
+                continue;
+            }
+
+            GraphResource previous = i;
+            bool previous_earlier = false;
+            for (GraphResource j = 0; j < this->resources.size(); j++) {
+                const Resource &other = this->resources[j];
+                if (!other.transient || trackers[j].entry_pass == UINT32_MAX
+                    || other.memory_slot != resource.memory_slot) {
+                    continue;
+                }
+
+                // Prefer the latest image that ends before this one starts; without one, the
+                // latest in the whole frame is the one still in the memory from last frame.
+                bool earlier = other.last_use < resource.first_use;
+                if (earlier != previous_earlier) {
+                    if (earlier) {
+                        previous = j;
+                        previous_earlier = true;
+                    }
+                } else if (other.last_use > this->resources[previous].last_use) {
+                    previous = j;
+                }
+            }
+
+            const Tracker &last = trackers[previous];
+            CompiledPass &entry = this->compiled[trackers[i].entry_pass];
+            GraphBarrier &barrier = entry.barriers[trackers[i].entry_barrier];
+            barrier.src.stages = last.write_stages | last.read_stages;
+            barrier.src.access = last.write_access;
+            entry.src_stages |= barrier.src.stages;
+        }
+
+        CompiledPass exit{EXIT_PASS, 0, 0, {}};
+        for (GraphResource i = 0; i < this->resources.size(); i++) {
+            const Resource &resource = this->resources[i];
+            if (!resource.exported) {
+                continue;
+            }
+
+            const Tracker &tracker = trackers[i];
+            const ResourceState &final_state = resource.final_state;
+            bool layout_change = resource.is_image && final_state.layout != tracker.layout;
+            bool pending_write = tracker.write_access != 0 && final_state.stages != 0;
+            bool ownership_change = resource.release_src_family != resource.release_dst_family;
+            if (!layout_change && !pending_write && !ownership_change) {
+                continue;
+            }
+
+            ResourceState src{
+                tracker.write_stages | tracker.read_stages, tracker.write_access, tracker.layout};
+            exit.barriers.push_back(GraphBarrier{i, src, final_state});
+            exit.src_stages |= src.stages;
+            exit.dst_stages |= final_state.stages;
+        }
+        if (!exit.barriers.empty()) {
+            this->compiled.push_back(exit);
+        }
+    }
+
+    void RenderGraph::record_barriers(
+        VkCommandBuffer command_buffer, const CompiledPass &entry
+    ) const {
+        std::vector<VkImageMemoryBarrier> image_barriers;
+        std::vector<VkBufferMemoryBarrier> buffer_barriers;
+
+        for (const GraphBarrier &barrier : entry.barriers) {
+            const Resource &resource = this->resources[barrier.resource];
+            bool exit = entry.pass == EXIT_PASS;
+            u32 src_family = exit ? resource.release_src_family : VK_QUEUE_FAMILY_IGNORED;
+            u32 dst_family = exit ? resource.release_dst_family : VK_QUEUE_FAMILY_IGNORED;
+            if (resource.is_image) {
+                VkImageMemoryBarrier image_barrier{};
+                image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                image_barrier.srcAccessMask = barrier.src.access;
+                image_barrier.dstAccessMask = barrier.dst.access;
+                image_barrier.oldLayout = barrier.src.layout;
+                image_barrier.newLayout = barrier.dst.layout;
+                image_barrier.srcQueueFamilyIndex = src_family;
+                image_barrier.dstQueueFamilyIndex = dst_family;
+                image_barrier.image = resource.image;
+                image_barrier.subresourceRange.aspectMask = resource.aspect;
+                image_barrier.subresourceRange.baseMipLevel = 0;
+                image_barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+                image_barrier.subresourceRange.baseArrayLayer = 0;
+                image_barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+                image_barriers.push_back(image_barrier);
+            } else {
+                VkBufferMemoryBarrier buffer_barrier{};
+                buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                buffer_barrier.srcAccessMask = barrier.src.access;
+                buffer_barrier.dstAccessMask = barrier.dst.access;
+                buffer_barrier.srcQueueFamilyIndex = src_family;
+                buffer_barrier.dstQueueFamilyIndex = dst_family;
+                buffer_barrier.buffer = resource.buffer;
+                buffer_barrier.offset = 0;
+                buffer_barrier.size = VK_WHOLE_SIZE;
+                buffer_barriers.push_back(buffer_barrier);
+            }
+        }
+
+        vkCmdPipelineBarrier(
+            command_buffer, entry.src_stages ? entry.src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            entry.dst_stages ? entry.dst_stages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+            nullptr, static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(),
+            static_cast<uint32_t>(image_barriers.size()), image_barriers.data()
+        );
+    }
+
+    void RenderGraph::record_barriers2(
+        VkCommandBuffer command_buffer, const CompiledPass &entry
+    ) const {
+        // The synchronization2 stage and access bits are a superset of the original ones with
+        // the same values, and a stage mask of 0 means none.
+        std::vector<VkImageMemoryBarrier2KHR> image_barriers;
+        std::vector<VkBufferMemoryBarrier2KHR> buffer_barriers;
+
+        for (const GraphBarrier &barrier : entry.barriers) {
+            const Resource &resource = this->resources[barrier.resource];
+            bool exit = entry.pass == EXIT_PASS;
+            u32 src_family = exit ? resource.release_src_family : VK_QUEUE_FAMILY_IGNORED;
+            u32 dst_family = exit ? resource.release_dst_family : VK_QUEUE_FAMILY_IGNORED;
+            if (resource.is_image) {
+                VkImageMemoryBarrier2KHR image_barrier{};
+                image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+                image_barrier.srcStageMask = barrier.src.stages;
+                image_barrier.srcAccessMask = barrier.src.access;
+                image_barrier.dstStageMask = barrier.dst.stages;
+                image_barrier.dstAccessMask = barrier.dst.access;
+                image_barrier.oldLayout = barrier.src.layout;
+                image_barrier.newLayout = barrier.dst.layout;
+                image_barrier.srcQueueFamilyIndex = src_family;
+                image_barrier.dstQueueFamilyIndex = dst_family;
+                image_barrier.image = resource.image;
+                image_barrier.subresourceRange.aspectMask = resource.aspect;
+                image_barrier.subresourceRange.baseMipLevel = 0;
+                image_barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+                image_barrier.subresourceRange.baseArrayLayer = 0;
+                image_barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+                image_barriers.push_back(image_barrier);
+            } else {
+                VkBufferMemoryBarrier2KHR buffer_barrier{};
+                buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR;
+                buffer_barrier.srcStageMask = barrier.src.stages;
+                buffer_barrier.srcAccessMask = barrier.src.access;
+                buffer_barrier.dstStageMask = barrier.dst.stages;
+                buffer_barrier.dstAccessMask = barrier.dst.access;
+                buffer_barrier.srcQueueFamilyIndex = src_family;
+                buffer_barrier.dstQueueFamilyIndex = dst_family;
+                buffer_barrier.buffer = resource.buffer;
+                buffer_barrier.offset = 0;
+                buffer_barrier.size = VK_WHOLE_SIZE;
+                buffer_barriers.push_back(buffer_barrier);
+            }
+        }
+
+        VkDependencyInfoKHR dependency_info{};
+        dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+        dependency_info.bufferMemoryBarrierCount = static_cast<uint32_t>(buffer_barriers.size());
+        dependency_info.pBufferMemoryBarriers = buffer_barriers.data();
+        dependency_info.imageMemoryBarrierCount = static_cast<uint32_t>(image_barriers.size());
+        dependency_info.pImageMemoryBarriers = image_barriers.data();
+        this->pipeline_barrier2(command_buffer, &dependency_info);
+    }
+
+    void RenderGraph::destroy_transient_images() {
+        for (Resource &resource : this->resources) {
+            if (!resource.transient || resource.image == VK_NULL_HANDLE) {
+                continue;
+            }
+
+            vkDestroyImageView(this->device, resource.view, nullptr);
+            vkDestroyImage(this->device, resource.image, nullptr);
+            resource.image = VK_NULL_HANDLE;
+            resource.view = VK_NULL_HANDLE;
+        }
+
+        for (MemorySlot &slot : this->memory_slots) {
+            this->allocator->free(slot.allocation);
+        }
+        this->memory_slots.clear();
+    }
+} // namespace TANELORN_ENGINE_NAMESPACE
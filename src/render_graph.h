@@ -0,0 +1,198 @@
+#pragma once
+
+#include "allocator.h"
+#include "defines.h"
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    // How a pass uses a resource. Each maps to the pipeline stages, access mask and image layout
+    // the graph synchronizes against.
+    enum class ResourceAccess {
+        ColorAttachmentWrite,
+        DepthAttachmentWrite,
+        VertexShaderRead,
+        FragmentShaderRead,
+        ComputeShaderRead,
+        ComputeShaderWrite,
+        IndirectCommandRead,
+        TransferRead,
+        TransferWrite,
+    };
+
+    // Synchronization state of a resource where it enters or leaves the graph.
+    struct ResourceState {
+        VkPipelineStageFlags stages;
+        VkAccessFlags access;
+        // Ignored for buffers.
+        VkImageLayout layout;
+    };
+
+    struct TransientImageDesc {
+        VkFormat format;
+        VkExtent2D extent;
+        VkImageUsageFlags usage;
+        VkImageAspectFlags aspect;
+    };
+
+    using GraphResource = u32;
+
+    struct GraphBarrier {
+        GraphResource resource;
+        ResourceState src;
+        ResourceState dst;
+    };
+
+    // A pass of the compiled schedule and the barriers recorded right before it, merged into
+    // one vkCmdPipelineBarrier.
+    struct CompiledPass {
+        u32 pass;
+        VkPipelineStageFlags src_stages;
+        VkPipelineStageFlags dst_stages;
+        std::vector<GraphBarrier> barriers;
+    };
+
+    struct RenderGraphStats {
+        u32 declared_passes;
+        u32 culled_passes;
+        u32 barriers;
+        u32 transient_images;
+        // Memory backing the transient images, and what it would take without aliasing.
+        VkDeviceSize transient_bytes;
+        VkDeviceSize unaliased_bytes;
+        f64 compile_ms;
+    };
+
+    // A declarative frame graph. Passes declare which resources they read and write; `compile`
+    // culls passes that contribute to no exported resource, places the minimal barriers and
+    // layout transitions between the rest, and backs transient images whose lifetimes do not
+    // overlap with the same memory. The schedule is compiled once and executed every frame;
+    // imported handles such as the swapchain image are rebound per frame without recompiling.
+    // Passes run in declaration order, which must already respect their dependencies.
+    class RenderGraph {
+    public:
+        using PassCallback = std::function<void(VkCommandBuffer)>;
+
+        static constexpr u32 EXIT_PASS = UINT32_MAX;
+
+        RenderGraph();
+        ~RenderGraph();
+
+        RenderGraph(const RenderGraph &) = delete;
+        RenderGraph &operator=(const RenderGraph &) = delete;
+
+        // With `pipeline_barrier2` from VK_KHR_synchronization2, each barrier carries its own
+        // stages instead of sharing the union of every barrier before the same pass.
+        void init(
+            VkDevice device, GpuAllocator &allocator,
+            PFN_vkCmdPipelineBarrier2KHR pipeline_barrier2 = nullptr
+        );
+        void destroy();
+        // Drops every pass and resource so the graph can be declared again. Transient images
+        // are destroyed right away, so the device must be done with them.
+        void reset();
+
+        // `initial` is the state the resource is in when the graph starts executing, such as
+        // the stage the acquire semaphore is waited on for a swapchain image.
+        GraphResource import_image(
+            const std::string &name, VkImageAspectFlags aspect, const ResourceState &initial
+        );
+        GraphResource import_buffer(const std::string &name, const ResourceState &initial);
+        // Owned by the graph, valid only between its first and last use in a frame.
+        GraphResource create_image(const std::string &name, const TransientImageDesc &desc);
+        // Marks an imported resource as a result of the frame: passes contributing to it are
+        // never culled, and it is left in `final_state` after the last pass. With queue
+        // families, the exit barrier is also the release half of an ownership transfer from
+        // `src_family` to `dst_family`; the other queue has to record the matching acquire.
+        void export_resource(
+            GraphResource resource, const ResourceState &final_state,
+            u32 src_family = VK_QUEUE_FAMILY_IGNORED, u32 dst_family = VK_QUEUE_FAMILY_IGNORED
+        );
+
+        u32 add_pass(const std::string &name, PassCallback record);
+        void read(u32 pass, GraphResource resource, ResourceAccess access);
+        void write(u32 pass, GraphResource resource, ResourceAccess access);
+
+        void compile();
+
+        void bind_image(GraphResource resource, VkImage image, VkImageView view);
+        void bind_buffer(GraphResource resource, VkBuffer buffer);
+        VkImage image(GraphResource resource) const;
+        VkImageView image_view(GraphResource resource) const;
+        VkBuffer buffer(GraphResource resource) const;
+
+        void execute(VkCommandBuffer command_buffer) const;
+
+        // Passes that survived culling, in execution order. The barriers into exported states
+        // come last, in an entry whose pass is EXIT_PASS.
+        const std::vector<CompiledPass> &schedule() const;
+        const std::string &pass_name(u32 pass) const;
+        const std::string &resource_name(GraphResource resource) const;
+        const RenderGraphStats &stats() const;
+        bool has_transient_images() const;
+        void print_schedule() const;
+
+    private:
+        struct Resource {
+            std::string name;
+            bool is_image;
+            bool transient;
+            bool exported;
+            VkImageAspectFlags aspect;
+            TransientImageDesc desc;
+            ResourceState initial;
+            ResourceState final_state;
+            // Queue families of the exit barrier; VK_QUEUE_FAMILY_IGNORED unless exported to
+            // another queue.
+            u32 release_src_family;
+            u32 release_dst_family;
+            VkImage image;
+            VkImageView view;
+            VkBuffer buffer;
+            // Transient images only.
+            u32 memory_slot;
+            u32 first_use;
+            u32 last_use;
+        };
+
+        struct PassAccess {
+            GraphResource resource;
+            ResourceAccess access;
+            bool write;
+        };
+
+        struct Pass {
+            std::string name;
+            PassCallback record;
+            std::vector<PassAccess> accesses;
+            bool culled;
+        };
+
+        struct MemorySlot {
+            VkMemoryRequirements requirements;
+            Allocation allocation;
+            // Schedule positions [first, last] of each image placed in the slot.
+            std::vector<std::pair<u32, u32>> lifetimes;
+        };
+
+        void cull_passes();
+        void allocate_transient_images();
+        void schedule_barriers();
+        void destroy_transient_images();
+        void record_barriers(VkCommandBuffer command_buffer, const CompiledPass &entry) const;
+        void record_barriers2(VkCommandBuffer command_buffer, const CompiledPass &entry) const;
+
+        VkDevice device;
+        GpuAllocator *allocator;
+        PFN_vkCmdPipelineBarrier2KHR pipeline_barrier2;
+        std::vector<Resource> resources;
+        std::vector<Pass> passes;
+        std::vector<MemorySlot> memory_slots;
+        std::vector<CompiledPass> compiled;
+        RenderGraphStats graph_stats;
+    };
+} // namespace TANELORN_ENGINE_NAMESPACE
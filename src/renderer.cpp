@@ -1,10 +1,57 @@
 #include "renderer.h"
-
+#include "cpu_profiler.h"
+#include "shader_manager.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <thread>
 
 const std::vector<const char *> validation_layers = {"VK_LAYER_KHRONOS_validation"};
 const std::vector<const char *> device_extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+const std::vector<const char *> present_wait_extensions = {
+    VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME};
+// Dynamic rendering depends on depth_stencil_resolve, which depends on create_renderpass2.
+const std::vector<const char *> dynamic_rendering_extensions = {
+    VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME,
+    VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME};
+// Descriptor indexing depends on maintenance3.
+const std::vector<const char *> required_extensions = {
+    VK_KHR_MAINTENANCE_3_EXTENSION_NAME, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
+    VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME};
+
+// Below this many draws per job, the cost of another secondary command buffer outweighs the
+// recording time it saves.
+constexpr u32 min_draws_per_record_job = 64;
+constexpr u32 max_record_workers = 8;
+// Bounds a present wait so a surface that stops presenting (minimized, occluded) can only stall
+// a frame, never hang it.
+constexpr u64 present_wait_timeout_ns = 100'000'000;
+
+constexpr const char *default_pipeline_cache_path = "pipeline_cache.bin";
+
+// Where draws may read compute results: indirect arguments, vertex data and shader reads, plus
+// the copy of the culling statistics.
+constexpr VkPipelineStageFlags compute_consumer_stages =
+    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+    | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+    | VK_PIPELINE_STAGE_TRANSFER_BIT;
+constexpr VkAccessFlags compute_consumer_access =
+    VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT
+    | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+// Instances tested by one workgroup of cull.comp, and its two passes.
+constexpr u32 cull_group_size = 256;
+constexpr u32 cull_count_pass = 0;
+constexpr u32 cull_compact_pass = 1;
+
+constexpr VkFormat headless_image_format = VK_FORMAT_R8G8B8A8_UNORM;
+constexpr VkDeviceSize headless_bytes_per_pixel = 4;
 
 #ifdef TN_RELEASE
 constexpr bool enable_validations = false;
@@ -15,6 +62,16 @@ constexpr bool enable_validations = true;
 struct QueueFamilyIndices {
     uint32_t graphics_family;
     bool graphics_family_found;
+    // A transfer-only family backed by a DMA engine, if the device exposes one.
+    uint32_t transfer_family;
+    bool transfer_family_found;
+    // A compute family without graphics, whose queue runs alongside the graphics queue.
+    uint32_t compute_family;
+    bool compute_family_found;
+    uint32_t compute_queue_count;
+    // Only searched for with a surface. The graphics family is preferred when it can present.
+    uint32_t present_family;
+    bool present_family_found;
 
     bool is_complete() const {
         return this->graphics_family_found;
@@ -27,7 +84,7 @@ struct SwapchainSupportDetails {
     std::vector<VkPresentModeKHR> present_modes;
 };
 
-static QueueFamilyIndices find_queue_families(VkPhysicalDevice device) {
+static QueueFamilyIndices find_queue_families(VkPhysicalDevice device, VkSurfaceKHR surface) {
     QueueFamilyIndices indices{};
 
     uint32_t queue_family_count = 0;
@@ -36,10 +93,56 @@ static QueueFamilyIndices find_queue_families(VkPhysicalDevice device) {
     std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, queue_families.data());
 
+    std::vector<bool> can_present(queue_family_count, false);
+    if (surface != VK_NULL_HANDLE) {
+        for (uint32_t i = 0; i < queue_family_count; i++) {
+            VkBool32 supported = VK_FALSE;
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &supported);
+            can_present[i] = supported;
+        }
+    }
+
+    // A graphics family that can also present saves an ownership transfer of every swapchain
+    // image, so it wins over an earlier graphics-only family.
     for (uint32_t i = 0; i < queue_family_count; i++) {
-        if (queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        if (!(queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+            continue;
+        }
+        if (!indices.graphics_family_found || can_present[i]) {
             indices.graphics_family = i;
             indices.graphics_family_found = true;
+        }
+        if (can_present[i]) {
+            indices.present_family = i;
+            indices.present_family_found = true;
+            break;
+        }
+    }
+
+    for (uint32_t i = 0; i < queue_family_count && !indices.present_family_found; i++) {
+        if (can_present[i]) {
+            indices.present_family = i;
+            indices.present_family_found = true;
+        }
+    }
+
+    for (uint32_t i = 0; i < queue_family_count; i++) {
+        VkQueueFlags flags = queue_families[i].queueFlags;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+            // Prefer a pure transfer family over one that also does compute.
+            if (!indices.transfer_family_found || !(flags & VK_QUEUE_COMPUTE_BIT)) {
+                indices.transfer_family = i;
+                indices.transfer_family_found = true;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < queue_family_count; i++) {
+        VkQueueFlags flags = queue_families[i].queueFlags;
+        if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+            indices.compute_family = i;
+            indices.compute_family_found = true;
+            indices.compute_queue_count = queue_families[i].queueCount;
             break;
         }
     }
@@ -47,6 +150,68 @@ static QueueFamilyIndices find_queue_families(VkPhysicalDevice device) {
     return indices;
 }
 
+static const char *device_type_name(VkPhysicalDeviceType type) {
+    switch (type) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+            return "discrete";
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+            return "integrated";
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+            return "virtual";
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:
+            return "cpu";
+        default:
+            return "other";
+    }
+}
+
+// The deviceUUID from VkPhysicalDeviceIDProperties, which stays stable across processes and
+// APIs. Devices older than Vulkan 1.1 fall back to their pipeline cache UUID.
+static void get_device_uuid(VkPhysicalDevice device, u8 (&uuid)[VK_UUID_SIZE]) {
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(device, &props);
+    memcpy(uuid, props.pipelineCacheUUID, VK_UUID_SIZE);
+
+    if (props.apiVersion >= VK_API_VERSION_1_1) {
+        VkPhysicalDeviceIDProperties id_props{};
+        id_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+        VkPhysicalDeviceProperties2 props2{};
+        props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        props2.pNext = &id_props;
+        vkGetPhysicalDeviceProperties2(device, &props2);
+
+        memcpy(uuid, id_props.deviceUUID, VK_UUID_SIZE);
+    }
+}
+
+// `pinned` is either a decimal enumeration index or a 32 digit hex device UUID.
+static bool device_matches(const char *pinned, uint32_t index, VkPhysicalDevice device) {
+    std::string digits;
+    for (const char *c = pinned; *c; c++) {
+        if (*c != '-') {
+            digits.push_back(static_cast<char>(tolower(static_cast<unsigned char>(*c))));
+        }
+    }
+
+    if (digits.size() == 2 * VK_UUID_SIZE) {
+        u8 uuid[VK_UUID_SIZE];
+        get_device_uuid(device, uuid);
+
+        static const char hex[] = "0123456789abcdef";
+        for (uint32_t i = 0; i < VK_UUID_SIZE; i++) {
+            if (digits[2 * i] != hex[uuid[i] >> 4] || digits[2 * i + 1] != hex[uuid[i] & 0xf]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    char *end = nullptr;
+    unsigned long value = strtoul(pinned, &end, 10);
+    return end != pinned && *end == '\0' && value == index;
+}
+
 static SwapchainSupportDetails
 query_swapchain_support(VkPhysicalDevice device, VkSurfaceKHR surface) {
     SwapchainSupportDetails details{};
@@ -85,10 +250,27 @@ choose_surface_format(const std::vector<VkSurfaceFormatKHR> &available_formats)
     return available_formats[0];
 }
 
-static VkPresentModeKHR
-choose_present_mode(const std::vector<VkPresentModeKHR> &available_present_modes) {
+static VkPresentModeKHR choose_present_mode(
+    const std::vector<VkPresentModeKHR> &available_present_modes, tn::PresentPolicy policy
+) {
+    VkPresentModeKHR requested = VK_PRESENT_MODE_FIFO_KHR;
+    switch (policy) {
+        case tn::PresentPolicy::Fifo:
+            requested = VK_PRESENT_MODE_FIFO_KHR;
+            break;
+        case tn::PresentPolicy::FifoRelaxed:
+            requested = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+            break;
+        case tn::PresentPolicy::Mailbox:
+            requested = VK_PRESENT_MODE_MAILBOX_KHR;
+            break;
+        case tn::PresentPolicy::Immediate:
+            requested = VK_PRESENT_MODE_IMMEDIATE_KHR;
+            break;
+    }
+
     for (const VkPresentModeKHR &present_mode : available_present_modes) {
-        if (present_mode == VK_PRESENT_MODE_MAILBOX_KHR) {
+        if (present_mode == requested) {
             return present_mode;
         }
     }
@@ -96,24 +278,6 @@ choose_present_mode(const std::vector<VkPresentModeKHR> &available_present_modes
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
-static std::vector<char> read_spv(const std::string &filename) {
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
-
-    if (!file.is_open()) {
-        std::cout << "Could not open the file: " << filename << std::endl;
-
-        return std::vector<char>();
-    } else {
-        usize file_size = file.tellg();
-        std::vector<char> buffer(file_size);
-        file.seekg(0);
-        file.read(buffer.data(), file_size);
-        file.close();
-
-        return buffer;
-    }
-}
-
 static VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(
     VkDebugUtilsMessageSeverityFlagBitsEXT message_severity,
     VkDebugUtilsMessageTypeFlagsEXT message_type,
@@ -141,7 +305,23 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(
 }
 
 namespace TANELORN_ENGINE_NAMESPACE {
-    Renderer::Renderer(const Window &window) {
+    Renderer::Renderer(const Window &window, u32 frames_in_flight, PresentPolicy present_policy)
+        : transfer_queue{VK_NULL_HANDLE}, compute_queue{VK_NULL_HANDLE},
+          present_queue{VK_NULL_HANDLE}, graphics_family{0}, transfer_family{0}, compute_family{0},
+          present_family{0}, surface{VK_NULL_HANDLE}, window{&window},
+          swapchain{VK_NULL_HANDLE}, reloaded_pipelines{},
+          frame_data_index{BindlessHeap::INVALID_INDEX},
+          frame_constants_index{0}, gpu_culling{false}, cull_pipeline{UINT32_MAX},
+          culling_counter{UINT32_MAX}, culling_readback_buffer{VK_NULL_HANDLE},
+          culling_readback_allocation{}, culling{}, draw_indirect_count_supported{false},
+          cmd_draw_indexed_indirect_count{nullptr}, dynamic_rendering_supported{false},
+          cmd_begin_rendering{nullptr}, cmd_end_rendering{nullptr}, cmd_pipeline_barrier2{nullptr},
+          pipeline_statistics_supported{false}, present_command_pool{VK_NULL_HANDLE},
+          frames_in_flight{frames_in_flight > 0 ? frames_in_flight : 1}, current_frame{0},
+          submitted_frames{0}, policy{present_policy}, present_wait_supported{false},
+          wait_for_present{nullptr}, first_present_id{1}, frame_interval{0}, frame_paced{false},
+          headless{false}, readback_buffer{VK_NULL_HANDLE}, readback_allocation{},
+          readback_slot_size{0}, stats{}, latency{}, has_last_frame_time{false} {
         this->create_instance();
 #ifndef TN_RELEASE
         this->create_debug_messenger();
@@ -149,41 +329,150 @@ namespace TANELORN_ENGINE_NAMESPACE {
         this->create_surface(window);
         this->create_physical_device();
         this->create_logical_device();
-        this->create_swapchain(window);
+        this->create_allocator();
+        this->create_pipeline_cache();
+        this->create_swapchain(window, VK_NULL_HANDLE);
         this->create_image_views();
         this->create_render_pass();
+        this->create_bindless_heap();
+        this->create_framebuffers();
+        this->create_command_pool();
+        this->create_command_buffers();
+        this->create_worker_command_pools();
         this->create_graphics_pipeline();
+        this->create_profiler();
+        this->create_render_graph();
+        this->create_sync_objects();
+        this->create_present_transfer();
+        this->create_uploader();
+        this->create_frame_allocator();
+        this->create_async_compute();
+        this->create_gpu_culling();
+        this->create_default_mesh();
+    }
+
+    Renderer::Renderer(VkExtent2D extent, u32 frames_in_flight)
+        : transfer_queue{VK_NULL_HANDLE}, compute_queue{VK_NULL_HANDLE},
+          present_queue{VK_NULL_HANDLE}, graphics_family{0}, transfer_family{0}, compute_family{0},
+          present_family{0}, surface{VK_NULL_HANDLE}, window{nullptr},
+          swapchain{VK_NULL_HANDLE}, reloaded_pipelines{},
+          frame_data_index{BindlessHeap::INVALID_INDEX},
+          frame_constants_index{0}, gpu_culling{false}, cull_pipeline{UINT32_MAX},
+          culling_counter{UINT32_MAX}, culling_readback_buffer{VK_NULL_HANDLE},
+          culling_readback_allocation{}, culling{}, draw_indirect_count_supported{false},
+          cmd_draw_indexed_indirect_count{nullptr}, dynamic_rendering_supported{false},
+          cmd_begin_rendering{nullptr}, cmd_end_rendering{nullptr}, cmd_pipeline_barrier2{nullptr},
+          pipeline_statistics_supported{false}, present_command_pool{VK_NULL_HANDLE},
+          frames_in_flight{frames_in_flight > 0 ? frames_in_flight : 1}, current_frame{0},
+          submitted_frames{0}, policy{PresentPolicy::Fifo}, present_wait_supported{false},
+          wait_for_present{nullptr}, first_present_id{1}, frame_interval{0}, frame_paced{false},
+          headless{true}, readback_buffer{VK_NULL_HANDLE}, readback_allocation{},
+          readback_slot_size{0}, stats{}, latency{}, has_last_frame_time{false} {
+        this->swapchain_image_format = headless_image_format;
+        this->swapchain_extent = extent;
+        this->swapchain_window_size = {
+            static_cast<i32>(extent.width), static_cast<i32>(extent.height)};
+
+        this->create_instance();
+#ifndef TN_RELEASE
+        this->create_debug_messenger();
+#endif
+        this->create_physical_device();
+        this->create_logical_device();
+        this->create_allocator();
+        this->create_pipeline_cache();
+        this->create_offscreen_images();
+        this->create_image_views();
+        this->create_render_pass();
+        this->create_bindless_heap();
         this->create_framebuffers();
         this->create_command_pool();
-        this->create_command_buffer();
+        this->create_command_buffers();
+        this->create_worker_command_pools();
+        this->create_graphics_pipeline();
+        this->create_profiler();
         this->create_sync_objects();
+        this->create_uploader();
+        this->create_frame_allocator();
+        this->create_async_compute();
+        this->create_gpu_culling();
+        this->create_default_mesh();
+        this->create_readback_buffer();
+        this->create_render_graph();
     }
 
     Renderer::~Renderer() {
-        vkDestroySemaphore(this->device, this->image_available_semaphore, nullptr);
-        vkDestroySemaphore(this->device, this->render_finished_semaphore, nullptr);
-        vkDestroyFence(this->device, this->in_flight_fence, nullptr);
+        // Stop the watcher first so no pipeline is built while the device is torn down.
+        this->shader_manager.destroy();
+        this->destroy_instance_batches();
+        this->destroy_meshes();
+        this->uploader.destroy();
+        this->frame_allocator.destroy();
+        this->compute.destroy();
+        this->destroy_compute_buffers();
+        this->allocator.destroy_buffer(
+            this->culling_readback_buffer, this->culling_readback_allocation
+        );
+        for (u32 i = 0; i < this->frames_in_flight; i++) {
+            vkDestroySemaphore(this->device, this->image_available_semaphores[i], nullptr);
+        }
+        this->graphics_timeline.destroy();
+        for (const VkSemaphore &semaphore : this->render_finished_semaphores) {
+            vkDestroySemaphore(this->device, semaphore, nullptr);
+        }
+        if (this->present_command_pool != VK_NULL_HANDLE) {
+            vkQueueWaitIdle(this->present_queue);
+            vkDestroyCommandPool(this->device, this->present_command_pool, nullptr);
+        }
+        for (const VkSemaphore &semaphore : this->present_ready_semaphores) {
+            vkDestroySemaphore(this->device, semaphore, nullptr);
+        }
         std::cout << "Destroyed sync objects.\n";
+        this->profiler.destroy();
+        this->graph.destroy();
+        this->destroy_retired_swapchains(true);
+        this->present_timeline.destroy();
+        this->jobs.destroy();
+        for (const VkCommandPool &pool : this->worker_command_pools) {
+            vkDestroyCommandPool(this->device, pool, nullptr);
+        }
         vkDestroyCommandPool(this->device, this->command_pool, nullptr);
         std::cout << "Destroyed command pool.\n";
         for (const VkFramebuffer &framebuffer : this->framebuffers) {
             vkDestroyFramebuffer(this->device, framebuffer, nullptr);
             std::cout << "Destroyed framebuffer.\n";
         }
-        vkDestroyPipeline(this->device, this->pipeline, nullptr);
-        std::cout << "Destroyed pipeline.\n";
+        this->pipelines.destroy_set(this->reloaded_pipelines);
+        this->destroy_retired_pipelines(true);
+        this->pipelines.destroy();
+        this->pipeline_cache.save();
+        this->pipeline_cache.destroy();
         vkDestroyPipelineLayout(this->device, this->pipeline_layout, nullptr);
         std::cout << "Destroyed pipeline layout.\n";
+        this->bindless.destroy();
         vkDestroyRenderPass(this->device, this->render_pass, nullptr);
         std::cout << "Destroyed render pass.\n";
         for (const VkImageView &image_view : this->swapchain_image_views) {
             vkDestroyImageView(this->device, image_view, nullptr);
             std::cout << "Destroyed image view.\n";
         }
-        vkDestroySwapchainKHR(this->device, this->swapchain, nullptr);
-        std::cout << "Destroyed swapchain.\n";
-        vkDestroySurfaceKHR(this->instance, this->surface, nullptr);
-        std::cout << "Destroyed surface.\n";
+        if (this->headless) {
+            this->allocator.destroy_buffer(this->readback_buffer, this->readback_allocation);
+            std::cout << "Destroyed readback buffer.\n";
+            for (usize i = 0; i < this->swapchain_images.size(); i++) {
+                this->allocator.destroy_image(
+                    this->swapchain_images[i], this->offscreen_image_allocations[i]
+                );
+                std::cout << "Destroyed offscreen image.\n";
+            }
+        } else {
+            vkDestroySwapchainKHR(this->device, this->swapchain, nullptr);
+            std::cout << "Destroyed swapchain.\n";
+            vkDestroySurfaceKHR(this->instance, this->surface, nullptr);
+            std::cout << "Destroyed surface.\n";
+        }
+        this->allocator.print_stats();
+        this->allocator.destroy();
         vkDestroyDevice(this->device, nullptr);
         std::cout << "Destroyed logical device.\n";
         if (enable_validations) {
@@ -214,52 +503,872 @@ namespace TANELORN_ENGINE_NAMESPACE {
         return *this;
     }
 
+    void Renderer::pace_frame() {
+        if (this->frame_paced) {
+            return;
+        }
+
+        TN_PROFILE_SCOPE("Renderer::pace_frame");
+
+        if (this->frame_interval.count() > 0) {
+            TN_PROFILE_SCOPE("frame limiter");
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (this->next_frame_time > now) {
+                std::this_thread::sleep_until(this->next_frame_time);
+            }
+            // A frame that ran late restarts the schedule rather than bursting to catch up.
+            this->next_frame_time = std::max(this->next_frame_time, now) + this->frame_interval;
+        }
+
+        // The frame that last used this slot was submitted `frames_in_flight` frames ago.
+        std::chrono::steady_clock::time_point previous_start =
+            this->frame_start_times[this->current_frame];
+        bool has_previous = previous_start != std::chrono::steady_clock::time_point{};
+
+        // Waiting on the present rather than only the timeline keeps the presentation engine's
+        // queue from growing beyond `frames_in_flight` images, which FIFO would otherwise allow.
+        if (this->present_wait_supported && has_previous) {
+            u64 present_id = this->submitted_frames + 1 - this->frames_in_flight;
+            if (present_id >= this->first_present_id) {
+                TN_PROFILE_SCOPE("present wait");
+                VkResult res = this->wait_for_present(
+                    this->device, this->swapchain, present_id, present_wait_timeout_ns
+                );
+                if (res == VK_SUCCESS) {
+                    this->add_latency_sample(previous_start);
+                }
+            }
+        }
+
+        // Only wait for the frame that last used this slot of the ring, so the CPU can record
+        // up to `frames_in_flight` frames ahead of the GPU.
+        {
+            TN_PROFILE_SCOPE("timeline wait");
+            this->graphics_timeline.wait(this->frame_values[this->current_frame]);
+        }
+        this->read_culling_results();
+        // Rendering only waits on uploads on the GPU, so nothing else would notice them finish.
+        this->uploader.poll();
+
+        if (!this->present_wait_supported && has_previous) {
+            this->add_latency_sample(previous_start);
+        }
+        this->frame_start_times[this->current_frame] = std::chrono::steady_clock::time_point{};
+
+        // That frame was the last to read this slot's frame data.
+        this->frame_allocator.begin_frame(this->current_frame);
+        this->begin_compute_frame();
+
+        this->paced_frame_start = std::chrono::steady_clock::now();
+        this->frame_paced = true;
+    }
+
     void Renderer::draw_frame() {
-        vkWaitForFences(this->device, 1, &this->in_flight_fence, VK_TRUE, UINT64_MAX);
-        vkResetFences(this->device, 1, &this->in_flight_fence);
+        VkCommandBuffer command_buffer = this->command_buffers[this->current_frame];
 
-        uint32_t image_index;
-        vkAcquireNextImageKHR(
-            this->device, this->swapchain, UINT64_MAX, this->image_available_semaphore,
-            VK_NULL_HANDLE, &image_index
-        );
+        this->pace_frame();
+        this->frame_paced = false;
 
-        vkResetCommandBuffer(this->command_buffer, 0);
-        this->record_command_buffer(image_index);
+        TN_PROFILE_SCOPE("Renderer::draw_frame");
+        this->destroy_retired_swapchains(false);
 
-        VkSubmitInfo submit_info{};
-        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        // Some surfaces (Wayland, and X11 on some drivers) never report the swapchain as out
+        // of date on resize, so watch the window as well.
+        FramebufferSize size = this->window->framebuffer_size();
+        if (size.width <= 0 || size.height <= 0) {
+            // Nothing can be presented while minimized; don't spin on an empty frame.
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            return;
+        }
+        if (size.width != this->swapchain_window_size.width
+            || size.height != this->swapchain_window_size.height) {
+            this->recreate_swapchain();
+        }
 
-        VkSemaphore wait_semaphores[] = {this->image_available_semaphore};
-        VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-        submit_info.waitSemaphoreCount = 1;
-        submit_info.pWaitSemaphores = wait_semaphores;
-        submit_info.pWaitDstStageMask = wait_stages;
-        submit_info.commandBufferCount = 1;
-        submit_info.pCommandBuffers = &this->command_buffer;
+        uint32_t image_index;
+        VkResult res;
+        {
+            TN_PROFILE_SCOPE("acquire");
+            res = vkAcquireNextImageKHR(
+                this->device, this->swapchain, UINT64_MAX,
+                this->image_available_semaphores[this->current_frame], VK_NULL_HANDLE,
+                &image_index
+            );
+        }
+        if (res == VK_ERROR_OUT_OF_DATE_KHR) {
+            // Nothing was submitted, so the slot's frame stays complete and the slot is reused
+            // by the next call. Only this frame is dropped.
+            this->recreate_swapchain();
+            return;
+        } else if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR) {
+            std::cout << "Failed to acquire swapchain image: " << res << std::endl;
+            return;
+        }
 
-        VkSemaphore signal_semaphores[] = {this->render_finished_semaphore};
-        submit_info.signalSemaphoreCount = 1;
-        submit_info.pSignalSemaphores = signal_semaphores;
+        vkResetCommandBuffer(command_buffer, 0);
+        this->record_command_buffer(command_buffer, image_index);
 
-        VkResult res = vkQueueSubmit(this->graphics_queue, 1, &submit_info, this->in_flight_fence);
+        // Acquire and present only take binary semaphores. The render finished semaphore is
+        // consumed by the present of this image, so it is keyed by swapchain image rather than
+        // by frame slot.
+        VkSemaphore render_finished = this->render_finished_semaphores[image_index];
+        this->graphics_timeline.add_wait(
+            this->image_available_semaphores[this->current_frame],
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+        );
+        this->graphics_timeline.add_command_buffer(command_buffer);
+        this->graphics_timeline.add_signal(render_finished);
+        {
+            TN_PROFILE_SCOPE("submit");
+            this->frame_values[this->current_frame] = this->graphics_timeline.submit();
+        }
+
+        VkSemaphore present_wait = render_finished;
+        if (this->present_family != this->graphics_family) {
+            present_wait = this->present_ready_semaphores[image_index];
+            this->submit_present_acquire(render_finished, present_wait);
+        }
 
         VkPresentInfoKHR present_info{};
         present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
         present_info.waitSemaphoreCount = 1;
-        present_info.pWaitSemaphores = signal_semaphores;
+        present_info.pWaitSemaphores = &present_wait;
         present_info.swapchainCount = 1;
         present_info.pSwapchains = &this->swapchain;
         present_info.pImageIndices = &image_index;
         present_info.pResults = nullptr;
 
-        vkQueuePresentKHR(this->graphics_queue, &present_info);
+        u64 present_id = this->submitted_frames + 1;
+        VkPresentIdKHR present_id_info{};
+        present_id_info.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        present_id_info.swapchainCount = 1;
+        present_id_info.pPresentIds = &present_id;
+        if (this->present_wait_supported) {
+            present_info.pNext = &present_id_info;
+        }
+
+        {
+            TN_PROFILE_SCOPE("present");
+            res = vkQueuePresentKHR(this->present_queue, &present_info);
+        }
+
+        this->frame_start_times[this->current_frame] = this->paced_frame_start;
+        this->submitted_frames++;
+        this->current_frame = (this->current_frame + 1) % this->frames_in_flight;
+        this->update_frame_stats();
+
+        if (res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR) {
+            this->recreate_swapchain();
+        }
     }
 
     void Renderer::wait_idle() {
         vkDeviceWaitIdle(this->device);
     }
 
+    u32 Renderer::render_to_image() {
+        u32 slot = this->current_frame;
+        VkCommandBuffer command_buffer = this->command_buffers[slot];
+
+        this->pace_frame();
+        this->frame_paced = false;
+
+        vkResetCommandBuffer(command_buffer, 0);
+        this->record_command_buffer(command_buffer, slot);
+
+        this->graphics_timeline.add_command_buffer(command_buffer);
+        {
+            TN_PROFILE_SCOPE("submit");
+            this->frame_values[slot] = this->graphics_timeline.submit();
+        }
+
+        this->frame_start_times[slot] = this->paced_frame_start;
+        this->submitted_frames++;
+        this->current_frame = (this->current_frame + 1) % this->frames_in_flight;
+        this->update_frame_stats();
+
+        return slot;
+    }
+
+    void Renderer::read_image(u32 slot, std::vector<u8> &pixels) {
+        this->graphics_timeline.wait(this->frame_values[slot]);
+
+        const u8 *mapped = static_cast<const u8 *>(this->readback_allocation.mapped);
+        const u8 *src = mapped + slot * this->readback_slot_size;
+        pixels.assign(src, src + this->readback_slot_size);
+    }
+
+    VkExtent2D Renderer::extent() const {
+        return this->swapchain_extent;
+    }
+
+    u32
+    Renderer::create_mesh(const std::vector<Vertex> &vertices, const std::vector<u32> &indices) {
+        // Vulkan has no zero-sized buffers.
+        if (vertices.empty() || indices.empty()) {
+            std::cout << "Cannot create a mesh without vertices or indices." << std::endl;
+            return UINT32_MAX;
+        }
+
+        Mesh mesh{};
+        mesh.index_count = static_cast<u32>(indices.size());
+        for (const Vertex &vertex : vertices) {
+            mesh.radius = std::max(
+                mesh.radius, std::sqrt(
+                                 vertex.position[0] * vertex.position[0]
+                                 + vertex.position[1] * vertex.position[1]
+                             )
+            );
+        }
+
+        VkDeviceSize vertex_size = sizeof(Vertex) * vertices.size();
+        VkDeviceSize index_size = sizeof(u32) * indices.size();
+        if (!this->create_shared_buffer(
+                vertex_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, mesh.vertex_buffer,
+                mesh.vertex_allocation
+            )
+            || !this->create_shared_buffer(
+                index_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, mesh.index_buffer,
+                mesh.index_allocation
+            )) {
+            std::cout << "Failed to create mesh buffers." << std::endl;
+            this->allocator.destroy_buffer(mesh.vertex_buffer, mesh.vertex_allocation);
+            this->allocator.destroy_buffer(mesh.index_buffer, mesh.index_allocation);
+            return UINT32_MAX;
+        }
+
+        this->uploader.upload_buffer(mesh.vertex_buffer, 0, vertices.data(), vertex_size);
+        mesh.upload_id =
+            this->uploader.upload_buffer(mesh.index_buffer, 0, indices.data(), index_size);
+
+        this->meshes.push_back(mesh);
+        return static_cast<u32>(this->meshes.size() - 1);
+    }
+
+    u32 Renderer::create_instance_batch(
+        u32 mesh, const std::vector<InstanceData> &instances, u32 pipeline
+    ) {
+        if (mesh >= this->meshes.size() || instances.empty()) {
+            std::cout << "Cannot create an instance batch without a mesh or instances."
+                      << std::endl;
+            return UINT32_MAX;
+        }
+
+        InstanceBatch batch{};
+        batch.mesh = mesh;
+        batch.pipeline = pipeline;
+        batch.instance_count = static_cast<u32>(instances.size());
+        batch.max_draw_count = 1;
+
+        VkDeviceSize instance_size = sizeof(InstanceData) * instances.size();
+        bool created = this->create_shared_buffer(
+            instance_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, batch.instance_buffer,
+            batch.instance_allocation
+        );
+        created = created
+                  && this->create_shared_buffer(
+                      sizeof(VkDrawIndexedIndirectCommand) * batch.max_draw_count,
+                      VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                      batch.indirect_buffer, batch.indirect_allocation
+                  );
+        created = created
+                  && this->create_shared_buffer(
+                      sizeof(u32),
+                      VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                      batch.count_buffer, batch.count_allocation
+                  );
+
+        // Rotation does not move a circle around the origin, so only offset and scale matter.
+        std::vector<ObjectBounds> bounds(instances.size());
+        for (usize i = 0; i < instances.size(); i++) {
+            bounds[i].center[0] = instances[i].offset[0];
+            bounds[i].center[1] = instances[i].offset[1];
+            bounds[i].radius = this->meshes[mesh].radius * std::abs(instances[i].scale);
+        }
+        VkDeviceSize bounds_size = sizeof(ObjectBounds) * bounds.size();
+        created = created
+                  && this->create_shared_buffer(
+                      bounds_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, batch.bounds_buffer,
+                      batch.bounds_allocation
+                  );
+        u32 cull_groups = (batch.instance_count + cull_group_size - 1) / cull_group_size;
+        batch.culled_draws = this->create_compute_buffer(
+            sizeof(CulledDrawHeader) + sizeof(u32) * (batch.instance_count + cull_groups),
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
+        );
+
+        // Without its slots the shaders would index past the descriptor array, so the batch is
+        // dropped before anything is uploaded into it.
+        if (created) {
+            batch.instance_buffer_index =
+                this->bindless.add_storage_buffer(batch.instance_buffer, 0, VK_WHOLE_SIZE);
+            batch.bounds_buffer_index =
+                this->bindless.add_storage_buffer(batch.bounds_buffer, 0, VK_WHOLE_SIZE);
+        } else {
+            batch.instance_buffer_index = BindlessHeap::INVALID_INDEX;
+            batch.bounds_buffer_index = BindlessHeap::INVALID_INDEX;
+        }
+        if (batch.instance_buffer_index == BindlessHeap::INVALID_INDEX
+            || batch.bounds_buffer_index == BindlessHeap::INVALID_INDEX) {
+            std::cout << (created ? "Bindless heap is out of storage buffer slots."
+                                  : "Failed to create instance batch buffers.")
+                      << std::endl;
+            this->destroy_instance_batch(batch);
+            return UINT32_MAX;
+        }
+
+        VkDrawIndexedIndirectCommand command{};
+        command.indexCount = this->meshes[mesh].index_count;
+        command.instanceCount = batch.instance_count;
+        command.firstIndex = 0;
+        command.vertexOffset = 0;
+        command.firstInstance = 0;
+        u32 draw_count = 1;
+
+        this->uploader.upload_buffer(batch.instance_buffer, 0, instances.data(), instance_size);
+        this->uploader.upload_buffer(batch.indirect_buffer, 0, &command, sizeof(command));
+        this->uploader.upload_buffer(batch.bounds_buffer, 0, bounds.data(), bounds_size);
+        batch.upload_id =
+            this->uploader.upload_buffer(batch.count_buffer, 0, &draw_count, sizeof(draw_count));
+
+        u32 id = static_cast<u32>(this->instance_batches.size());
+        batch.scope_name = this->profiler.add_name("draw " + std::to_string(id));
+        this->instance_batches.push_back(batch);
+        return id;
+    }
+
+    void Renderer::clear_instance_batches() {
+        vkDeviceWaitIdle(this->device);
+        this->destroy_instance_batches();
+        // The next frame's compute work may already take the destroyed culled draws over from
+        // graphics, so it starts over.
+        if (this->frame_paced) {
+            this->begin_compute_frame();
+        }
+    }
+
+    const UploadStats &Renderer::upload_stats() const {
+        return this->uploader.stats();
+    }
+
+    AllocatorStats Renderer::memory_stats() const {
+        return this->allocator.stats();
+    }
+
+    void Renderer::create_uploader() {
+        this->uploader.init(
+            this->device, this->allocator, this->transfer_family, this->transfer_queue
+        );
+    }
+
+    void Renderer::create_frame_allocator() {
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(this->physical_device, &props);
+        VkDeviceSize min_alignment = std::max(
+            props.limits.minUniformBufferOffsetAlignment,
+            props.limits.minStorageBufferOffsetAlignment
+        );
+
+        this->frame_allocator.init(
+            this->device, this->allocator, this->frames_in_flight, min_alignment
+        );
+        this->frame_data_index =
+            this->bindless.add_storage_buffer(this->frame_allocator.buffer(), 0, VK_WHOLE_SIZE);
+        this->start_time = std::chrono::steady_clock::now();
+    }
+
+    void Renderer::write_frame_constants() {
+        // Aligned to its own size so the shader can index the buffer as an array of them.
+        FrameAllocation allocation =
+            this->frame_allocator.allocate(sizeof(FrameConstants), sizeof(FrameConstants));
+        if (!allocation.mapped) {
+            return;
+        }
+
+        std::chrono::duration<f32> time = std::chrono::steady_clock::now() - this->start_time;
+
+        FrameConstants constants{};
+        constants.time = time.count();
+        constants.delta_time = static_cast<f32>(this->stats.last_frame_ms / 1000.0);
+        constants.extent[0] = static_cast<f32>(this->swapchain_extent.width);
+        constants.extent[1] = static_cast<f32>(this->swapchain_extent.height);
+        memcpy(allocation.mapped, &constants, sizeof(constants));
+
+        this->frame_constants_index =
+            static_cast<u32>(allocation.offset / sizeof(FrameConstants));
+    }
+
+    FrameAllocation Renderer::allocate_frame_data(VkDeviceSize size, VkDeviceSize alignment) {
+        this->pace_frame();
+        return this->frame_allocator.allocate(size, alignment);
+    }
+
+    u32 Renderer::request_pipeline(const PipelineDesc &desc) {
+        return this->pipelines.request(desc);
+    }
+
+    void Renderer::prewarm_pipelines(const std::vector<PipelineDesc> &descs) {
+        for (const PipelineDesc &desc : descs) {
+            this->pipelines.request(desc);
+        }
+        this->pipelines.build_pending(this->jobs);
+    }
+
+    const PipelineRegistryStats &Renderer::pipeline_stats() const {
+        return this->pipelines.stats();
+    }
+
+    u32 Renderer::frame_data_slot() const {
+        return this->frame_data_index;
+    }
+
+    const FrameAllocatorStats &Renderer::frame_data_stats() const {
+        return this->frame_allocator.stats();
+    }
+
+    u32 Renderer::create_compute_pipeline(const SpirvCode &code) {
+        return this->compute.create_pipeline(code);
+    }
+
+    u32 Renderer::create_compute_buffer(VkDeviceSize size, VkBufferUsageFlags usage) {
+        u32 id = 0;
+        while (id < this->compute_buffers.size() && !this->compute_buffers[id].buffers.empty()) {
+            id++;
+        }
+
+        ComputeBuffer buffer{};
+        buffer.size = size;
+        buffer.buffers.resize(this->frames_in_flight, VK_NULL_HANDLE);
+        buffer.allocations.resize(this->frames_in_flight);
+        buffer.bindless_indices.resize(this->frames_in_flight, BindlessHeap::INVALID_INDEX);
+        buffer.graphics_owned.resize(this->frames_in_flight, false);
+
+        // Exclusive to one family at a time; ownership moves between compute and graphics
+        // every frame when they differ.
+        VkBufferCreateInfo create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        create_info.size = size;
+        create_info.usage = usage | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        for (u32 i = 0; i < this->frames_in_flight; i++) {
+            if (!this->allocator.create_buffer(
+                    create_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer.buffers[i],
+                    buffer.allocations[i]
+                )) {
+                continue;
+            }
+            buffer.bindless_indices[i] =
+                this->bindless.add_storage_buffer(buffer.buffers[i], 0, VK_WHOLE_SIZE);
+            if (buffer.bindless_indices[i] == BindlessHeap::INVALID_INDEX) {
+                std::cout << "Bindless heap is out of storage buffer slots." << std::endl;
+            }
+        }
+
+        if (id == this->compute_buffers.size()) {
+            this->compute_buffers.push_back(buffer);
+        } else {
+            this->compute_buffers[id] = buffer;
+        }
+        return id;
+    }
+
+    u32 Renderer::compute_buffer_slot(u32 buffer) const {
+        return this->compute_buffers[buffer].bindless_indices[this->current_frame];
+    }
+
+    void Renderer::dispatch_compute(
+        u32 pipeline, u32 groups_x, u32 groups_y, u32 groups_z, const void *push_constants,
+        u32 push_constant_size
+    ) {
+        this->pace_frame();
+        this->compute.dispatch(
+            pipeline, groups_x, groups_y, groups_z, push_constants, push_constant_size
+        );
+    }
+
+    const ComputeStats &Renderer::compute_stats() const {
+        return this->compute.stats();
+    }
+
+    void Renderer::set_gpu_culling(bool enabled) {
+        this->gpu_culling = enabled && this->cull_pipeline != UINT32_MAX
+                            && this->culling_readback_buffer != VK_NULL_HANDLE;
+        this->culling.enabled = this->gpu_culling;
+    }
+
+    const CullingStats &Renderer::culling_stats() const {
+        return this->culling;
+    }
+
+    void Renderer::create_async_compute() {
+        this->compute.init(
+            this->device, this->pipeline_cache, this->bindless.layout(), this->bindless.set(),
+            this->compute_family, this->compute_queue, this->frames_in_flight,
+            this->compute_family != this->graphics_family ? nullptr : &this->graphics_timeline
+        );
+    }
+
+    void Renderer::begin_compute_frame() {
+        this->compute.begin_frame(this->current_frame);
+
+        // Copies the graphics family handed back at the end of their last frame. A dropped
+        // frame records this again, so ownership only changes hands on submission.
+        for (const ComputeBuffer &buffer : this->compute_buffers) {
+            if (!buffer.buffers.empty() && buffer.graphics_owned[this->current_frame]) {
+                this->compute.acquire(buffer.buffers[this->current_frame], this->graphics_family);
+            }
+        }
+    }
+
+    u64 Renderer::submit_compute() {
+        if (this->compute.stats().async) {
+            for (ComputeBuffer &buffer : this->compute_buffers) {
+                if (buffer.buffers.empty()) {
+                    continue;
+                }
+                this->compute.release(buffer.buffers[this->current_frame], this->graphics_family);
+                buffer.graphics_owned[this->current_frame] = false;
+            }
+        }
+        return this->compute.submit(compute_consumer_stages, compute_consumer_access);
+    }
+
+    void Renderer::transfer_compute_buffers(VkCommandBuffer command_buffer, bool acquire) {
+        // Draws only read the results, so releasing back to compute needs no access mask; the
+        // next frame to use the copy starts after this one completed.
+        for (ComputeBuffer &buffer : this->compute_buffers) {
+            if (buffer.buffers.empty()) {
+                continue;
+            }
+            VkBuffer copy = buffer.buffers[this->current_frame];
+            if (acquire) {
+                record_buffer_ownership_transfer(
+                    command_buffer, copy, this->compute_family, this->graphics_family, 0, 0,
+                    compute_consumer_stages, compute_consumer_access
+                );
+            } else {
+                record_buffer_ownership_transfer(
+                    command_buffer, copy, this->graphics_family, this->compute_family,
+                    compute_consumer_stages, 0, 0, 0
+                );
+                buffer.graphics_owned[this->current_frame] = true;
+            }
+        }
+    }
+
+    void Renderer::destroy_compute_buffer(ComputeBuffer &buffer) {
+        for (u32 i = 0; i < buffer.buffers.size(); i++) {
+            if (buffer.buffers[i] == VK_NULL_HANDLE) {
+                continue;
+            }
+            this->allocator.destroy_buffer(buffer.buffers[i], buffer.allocations[i]);
+            this->bindless.release(BindlessKind::StorageBuffer, buffer.bindless_indices[i]);
+        }
+        buffer = ComputeBuffer{};
+    }
+
+    void Renderer::destroy_compute_buffers() {
+        for (ComputeBuffer &buffer : this->compute_buffers) {
+            this->destroy_compute_buffer(buffer);
+        }
+        this->compute_buffers.clear();
+    }
+
+    void Renderer::create_gpu_culling() {
+        this->cull_pipeline = this->compute.create_pipeline(embedded_spirv("cull.comp"));
+        this->culling_counter = this->create_compute_buffer(
+            sizeof(u32), VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
+        );
+        this->culling_objects.assign(this->frames_in_flight, 0);
+
+        VkBufferCreateInfo create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        create_info.size = sizeof(u32) * this->frames_in_flight;
+        create_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if (!this->allocator.create_buffer(
+                create_info,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                this->culling_readback_buffer, this->culling_readback_allocation
+            )) {
+            this->culling_readback_buffer = VK_NULL_HANDLE;
+        }
+
+        this->set_gpu_culling(true);
+        if (this->gpu_culling) {
+            std::cout << "Successfully created GPU culling." << std::endl;
+        }
+    }
+
+    bool Renderer::culls(const InstanceBatch &batch) const {
+        return this->gpu_culling
+               && this->compute_buffers[batch.culled_draws].bindless_indices[this->current_frame]
+                      != BindlessHeap::INVALID_INDEX
+               && batch.bounds_buffer_index != BindlessHeap::INVALID_INDEX;
+    }
+
+    void Renderer::record_culling(u64 upload_value) {
+        if (!this->gpu_culling) {
+            return;
+        }
+
+        // Every draw is zeroed before the first dispatch, so the fills share one barrier.
+        u32 objects = 0;
+        for (u32 index : this->draw_list) {
+            const InstanceBatch &batch = this->instance_batches[index];
+            if (this->culls(batch)) {
+                this->compute.fill(
+                    this->compute_buffers[batch.culled_draws].buffers[this->current_frame], 0,
+                    sizeof(CulledDrawHeader), 0
+                );
+                objects += batch.instance_count;
+            }
+        }
+        if (objects == 0) {
+            return;
+        }
+
+        const ComputeBuffer &counter = this->compute_buffers[this->culling_counter];
+        this->compute.fill(counter.buffers[this->current_frame], 0, sizeof(u32), 0);
+        // The bounds come from the transfer queue like the rest of the batch.
+        this->compute.timeline().add_wait(
+            this->uploader.timeline(), upload_value, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+        );
+
+        // Matches `Constants` in cull.comp.
+        struct {
+            u32 bounds_buffer;
+            u32 draw_buffer;
+            u32 counter_buffer;
+            u32 object_count;
+            u32 index_count;
+            u32 pass;
+        } constants;
+        constants.counter_buffer = counter.bindless_indices[this->current_frame];
+
+        // Every batch's count pass, then every batch's compact pass, which places each group's
+        // survivors after the counts of the groups before it.
+        for (u32 pass : {cull_count_pass, cull_compact_pass}) {
+            constants.pass = pass;
+            for (u32 index : this->draw_list) {
+                const InstanceBatch &batch = this->instance_batches[index];
+                if (!this->culls(batch) || batch.instance_count == 0) {
+                    continue;
+                }
+
+                const ComputeBuffer &draws = this->compute_buffers[batch.culled_draws];
+                constants.bounds_buffer = batch.bounds_buffer_index;
+                constants.draw_buffer = draws.bindless_indices[this->current_frame];
+                constants.object_count = batch.instance_count;
+                constants.index_count = this->meshes[batch.mesh].index_count;
+                this->compute.dispatch(
+                    this->cull_pipeline,
+                    (batch.instance_count + cull_group_size - 1) / cull_group_size, 1, 1,
+                    &constants, sizeof(constants)
+                );
+            }
+        }
+        this->culling_objects[this->current_frame] = objects;
+    }
+
+    void Renderer::record_culling_readback(VkCommandBuffer command_buffer) {
+        if (this->culling_objects[this->current_frame] == 0) {
+            return;
+        }
+
+        VkBufferCopy region{};
+        region.srcOffset = 0;
+        region.dstOffset = sizeof(u32) * this->current_frame;
+        region.size = sizeof(u32);
+        vkCmdCopyBuffer(
+            command_buffer,
+            this->compute_buffers[this->culling_counter].buffers[this->current_frame],
+            this->culling_readback_buffer, 1, &region
+        );
+
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = this->culling_readback_buffer;
+        barrier.offset = region.dstOffset;
+        barrier.size = region.size;
+        vkCmdPipelineBarrier(
+            command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0,
+            nullptr, 1, &barrier, 0, nullptr
+        );
+    }
+
+    void Renderer::read_culling_results() {
+        u32 objects = this->culling_objects[this->current_frame];
+        if (objects == 0) {
+            return;
+        }
+        this->culling_objects[this->current_frame] = 0;
+
+        const u32 *visible = static_cast<const u32 *>(this->culling_readback_allocation.mapped);
+        this->culling.objects = objects;
+        this->culling.visible = std::min(visible[this->current_frame], objects);
+        this->culling.culled = objects - this->culling.visible;
+        this->culling.total_culled += this->culling.culled;
+    }
+
+    void Renderer::create_default_mesh() {
+        std::vector<Vertex> vertices = {
+            {{0.0f, -0.5f}, {1.0f, 0.0f, 0.0f}},
+            {{0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}},
+            {{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}},
+        };
+        std::vector<u32> indices = {0, 1, 2};
+
+        u32 mesh = this->create_mesh(vertices, indices);
+
+        InstanceData identity{};
+        identity.scale = 1.0f;
+        identity.color[0] = 1.0f;
+        identity.color[1] = 1.0f;
+        identity.color[2] = 1.0f;
+        identity.color[3] = 1.0f;
+        this->create_instance_batch(mesh, {identity});
+    }
+
+    void Renderer::destroy_meshes() {
+        for (Mesh &mesh : this->meshes) {
+            this->allocator.destroy_buffer(mesh.vertex_buffer, mesh.vertex_allocation);
+            this->allocator.destroy_buffer(mesh.index_buffer, mesh.index_allocation);
+        }
+        this->meshes.clear();
+        std::cout << "Destroyed meshes.\n";
+    }
+
+    void Renderer::destroy_instance_batch(InstanceBatch &batch) {
+        this->allocator.destroy_buffer(batch.instance_buffer, batch.instance_allocation);
+        this->allocator.destroy_buffer(batch.indirect_buffer, batch.indirect_allocation);
+        this->allocator.destroy_buffer(batch.count_buffer, batch.count_allocation);
+        this->bindless.release(BindlessKind::StorageBuffer, batch.instance_buffer_index);
+        this->allocator.destroy_buffer(batch.bounds_buffer, batch.bounds_allocation);
+        this->bindless.release(BindlessKind::StorageBuffer, batch.bounds_buffer_index);
+        this->destroy_compute_buffer(this->compute_buffers[batch.culled_draws]);
+    }
+
+    void Renderer::destroy_instance_batches() {
+        for (InstanceBatch &batch : this->instance_batches) {
+            this->destroy_instance_batch(batch);
+        }
+        this->instance_batches.clear();
+    }
+
+    bool Renderer::create_shared_buffer(
+        VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer &buffer, Allocation &allocation
+    ) {
+        // Buffers written on a separate transfer family are shared concurrently so the graphics
+        // and compute queues can read them without an ownership transfer.
+        u32 families[3] = {this->graphics_family};
+        u32 family_count = 1;
+        for (u32 family : {this->transfer_family, this->compute_family}) {
+            if (std::find(families, families + family_count, family) == families + family_count) {
+                families[family_count++] = family;
+            }
+        }
+        bool shared = family_count > 1;
+
+        VkBufferCreateInfo create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        create_info.size = size;
+        create_info.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        create_info.sharingMode = shared ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+        create_info.queueFamilyIndexCount = shared ? family_count : 0;
+        create_info.pQueueFamilyIndices = shared ? families : nullptr;
+
+        return this->allocator.create_buffer(
+            create_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, allocation
+        );
+    }
+
+    const FrameStats &Renderer::frame_stats() const {
+        return this->stats;
+    }
+
+    const LatencyStats &Renderer::latency_stats() const {
+        return this->latency;
+    }
+
+    const GpuProfiler &Renderer::gpu_profiler() const {
+        return this->profiler;
+    }
+
+    const RenderGraph &Renderer::render_graph() const {
+        return this->graph;
+    }
+
+    void Renderer::reset_frame_stats() {
+        this->stats = FrameStats{};
+        this->latency = LatencyStats{};
+    }
+
+    void Renderer::set_present_policy(PresentPolicy policy) {
+        if (this->headless || policy == this->policy) {
+            return;
+        }
+
+        this->policy = policy;
+        this->recreate_swapchain();
+    }
+
+    PresentPolicy Renderer::present_policy() const {
+        return this->policy;
+    }
+
+    void Renderer::set_frame_limit(f64 frames_per_second) {
+        this->frame_interval =
+            frames_per_second > 0.0
+                ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                      std::chrono::duration<f64>(1.0 / frames_per_second)
+                  )
+                : std::chrono::steady_clock::duration::zero();
+        this->next_frame_time = std::chrono::steady_clock::now();
+    }
+
+    bool Renderer::present_wait_enabled() const {
+        return this->present_wait_supported;
+    }
+
+    void Renderer::add_latency_sample(std::chrono::steady_clock::time_point frame_start) {
+        f64 latency_ms =
+            std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - frame_start)
+                .count();
+
+        this->latency.last_ms = latency_ms;
+        this->latency.max_ms = std::max(this->latency.max_ms, latency_ms);
+        this->latency.total_ms += latency_ms;
+        this->latency.sample_count++;
+    }
+
+    void Renderer::update_frame_stats() {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+        if (this->has_last_frame_time) {
+            f64 frame_ms =
+                std::chrono::duration<f64, std::milli>(now - this->last_frame_time).count();
+
+            if (this->stats.frame_count == 0 || frame_ms < this->stats.min_frame_ms) {
+                this->stats.min_frame_ms = frame_ms;
+            }
+            if (frame_ms > this->stats.max_frame_ms) {
+                this->stats.max_frame_ms = frame_ms;
+            }
+            this->stats.last_frame_ms = frame_ms;
+            this->stats.total_frame_ms += frame_ms;
+            this->stats.frame_count++;
+        }
+
+        this->last_frame_time = now;
+        this->has_last_frame_time = true;
+    }
+
     void Renderer::create_instance() {
         VkApplicationInfo app_info{};
         app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -267,13 +1376,15 @@ namespace TANELORN_ENGINE_NAMESPACE {
         app_info.applicationVersion = VK_MAKE_API_VERSION(0, 0, 1, 0);
         app_info.pEngineName = "Tanelorn Engine";
         app_info.engineVersion = VK_MAKE_API_VERSION(0, 0, 1, 0);
-        app_info.apiVersion = VK_API_VERSION_1_0;
+        // 1.1 for vkGetPhysicalDeviceFeatures2, used to query optional extension features.
+        app_info.apiVersion = VK_API_VERSION_1_1;
 
         VkInstanceCreateInfo create_info{};
         create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
         create_info.pApplicationInfo = &app_info;
 
-        std::vector<const char *> extensions = Renderer::get_required_instance_extensions();
+        std::vector<const char *> extensions =
+            Renderer::get_required_instance_extensions(this->headless);
 
         create_info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
         create_info.ppEnabledExtensionNames = extensions.data();
@@ -346,47 +1457,270 @@ namespace TANELORN_ENGINE_NAMESPACE {
         std::vector<VkPhysicalDevice> devices(device_count);
         vkEnumeratePhysicalDevices(this->instance, &device_count, devices.data());
 
-        for (const VkPhysicalDevice &device : devices) {
-            if (Renderer::is_device_suitable(device)) {
-                VkPhysicalDeviceProperties props;
-                vkGetPhysicalDeviceProperties(device, &props);
-                std::cout << "Selected device: " << props.deviceName << std::endl;
-                this->physical_device = device;
-                break;
+        // TN_DEVICE pins a device by enumeration index or by device UUID (32 hex digits, dashes
+        // ignored). A pinned device that cannot run the renderer falls back to scoring.
+        const char *pinned = getenv("TN_DEVICE");
+
+        i64 best_score = -1;
+        bool best_pinned = false;
+
+        for (uint32_t i = 0; i < device_count; i++) {
+            VkPhysicalDeviceProperties props;
+            vkGetPhysicalDeviceProperties(devices[i], &props);
+
+            std::string reason;
+            i64 score = this->rate_device(devices[i], reason);
+            bool is_pinned = pinned && device_matches(pinned, i, devices[i]);
+
+            u8 uuid[VK_UUID_SIZE];
+            get_device_uuid(devices[i], uuid);
+            std::cout << "Device " << i << ": " << props.deviceName << " ("
+                      << device_type_name(props.deviceType) << ", uuid ";
+            for (u8 byte : uuid) {
+                static const char hex[] = "0123456789abcdef";
+                std::cout << hex[byte >> 4] << hex[byte & 0xf];
+            }
+            std::cout << ") ";
+            if (score < 0) {
+                std::cout << "rejected: " << reason << std::endl;
+                if (is_pinned) {
+                    std::cout << "Ignoring TN_DEVICE=" << pinned << ", the device is unusable."
+                              << std::endl;
+                }
+                continue;
+            }
+            std::cout << "score " << score << (is_pinned ? " (pinned by TN_DEVICE)" : "")
+                      << std::endl;
+
+            if ((is_pinned && !best_pinned) || (is_pinned == best_pinned && score > best_score)) {
+                this->physical_device = devices[i];
+                best_score = score;
+                best_pinned = is_pinned;
             }
         }
+
+        if (best_score < 0) {
+            std::cout << "No usable Vulkan device found." << std::endl;
+            return;
+        }
+
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(this->physical_device, &props);
+        std::cout << "Selected device: " << props.deviceName
+                  << (best_pinned ? " (pinned by TN_DEVICE)" : " (highest score)") << std::endl;
     }
 
     void Renderer::create_logical_device() {
-        QueueFamilyIndices indices = find_queue_families(this->physical_device);
+        QueueFamilyIndices indices = find_queue_families(this->physical_device, this->surface);
+
+        this->graphics_family = indices.graphics_family;
+        this->transfer_family =
+            indices.transfer_family_found ? indices.transfer_family : indices.graphics_family;
+
+        // TN_ASYNC_COMPUTE=0 submits compute work on the graphics queue even when the device
+        // has a separate compute family.
+        const char *async_compute = getenv("TN_ASYNC_COMPUTE");
+        bool use_async_compute = indices.compute_family_found
+                                 && (!async_compute || strcmp(async_compute, "0") != 0);
+        this->compute_family = use_async_compute ? indices.compute_family : this->graphics_family;
+        this->present_family = this->headless ? this->graphics_family : indices.present_family;
+
+        float queue_priorities[] = {1.0f, 1.0f};
+        std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
 
         VkDeviceQueueCreateInfo queue_create_info{};
         queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        queue_create_info.queueFamilyIndex = indices.graphics_family;
+        queue_create_info.queueFamilyIndex = this->graphics_family;
         queue_create_info.queueCount = 1;
+        queue_create_info.pQueuePriorities = queue_priorities;
+        queue_create_infos.push_back(queue_create_info);
+
+        // Without a transfer-only family, uploads fall back to the compute family. They get a
+        // queue of their own there when the family has two, and share the compute queue
+        // otherwise; both are submitted from the render thread.
+        u32 transfer_queue_index = 0;
+        if (this->compute_family != this->graphics_family) {
+            queue_create_info.queueFamilyIndex = this->compute_family;
+            if (this->transfer_family == this->compute_family && indices.compute_queue_count > 1) {
+                queue_create_info.queueCount = 2;
+                transfer_queue_index = 1;
+            }
+            queue_create_infos.push_back(queue_create_info);
+            queue_create_info.queueCount = 1;
+        }
+
+        if (this->transfer_family != this->graphics_family
+            && this->transfer_family != this->compute_family) {
+            queue_create_info.queueFamilyIndex = this->transfer_family;
+            queue_create_infos.push_back(queue_create_info);
+        }
+
+        // A present family shared with compute or transfer presents from their first queue.
+        if (this->present_family != this->graphics_family
+            && this->present_family != this->compute_family
+            && this->present_family != this->transfer_family) {
+            queue_create_info.queueFamilyIndex = this->present_family;
+            queue_create_infos.push_back(queue_create_info);
+        }
 
-        float queue_priority = 1.0f;
-        queue_create_info.pQueuePriorities = &queue_priority;
+        // Pipeline statistics are gathered around the render pass, which runs secondary
+        // command buffers, so they also need inherited queries.
+        VkPhysicalDeviceFeatures supported_features;
+        vkGetPhysicalDeviceFeatures(this->physical_device, &supported_features);
+        this->pipeline_statistics_supported =
+            supported_features.pipelineStatisticsQuery && supported_features.inheritedQueries;
 
         VkPhysicalDeviceFeatures device_features{};
+        device_features.pipelineStatisticsQuery = this->pipeline_statistics_supported;
+        device_features.inheritedQueries = this->pipeline_statistics_supported;
+        BindlessHeap::enable_core_features(device_features);
 
         VkDeviceCreateInfo create_info{};
         create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-        create_info.pQueueCreateInfos = &queue_create_info;
-        create_info.queueCreateInfoCount = 1;
+        create_info.pQueueCreateInfos = queue_create_infos.data();
+        create_info.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size());
         create_info.pEnabledFeatures = &device_features;
-        create_info.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
-        create_info.ppEnabledExtensionNames = device_extensions.data();
+        std::vector<const char *> extensions = this->get_required_device_extensions();
+
+        // rate_device only accepts devices that support these.
+        VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_features =
+            QueueTimeline::required_features();
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptor_indexing_features =
+            BindlessHeap::required_features();
+        descriptor_indexing_features.pNext = &timeline_features;
+        create_info.pNext = &descriptor_indexing_features;
+
+        std::vector<const char *> draw_indirect_count_extension = {
+            VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME};
+        this->draw_indirect_count_supported = Renderer::check_device_extension_support(
+            this->physical_device, draw_indirect_count_extension
+        );
+        if (this->draw_indirect_count_supported) {
+            extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+        }
+
+        VkPhysicalDeviceProperties device_props;
+        vkGetPhysicalDeviceProperties(this->physical_device, &device_props);
+
+        VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features{};
+        present_wait_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        VkPhysicalDevicePresentIdFeaturesKHR present_id_features{};
+        present_id_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        present_id_features.pNext = &present_wait_features;
+
+        if (!this->headless && device_props.apiVersion >= VK_API_VERSION_1_1
+            && Renderer::check_device_extension_support(
+                this->physical_device, present_wait_extensions
+            )) {
+            VkPhysicalDeviceFeatures2 features{};
+            features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features.pNext = &present_id_features;
+            vkGetPhysicalDeviceFeatures2(this->physical_device, &features);
+
+            this->present_wait_supported =
+                present_id_features.presentId && present_wait_features.presentWait;
+        }
+        if (this->present_wait_supported) {
+            present_wait_features.pNext = const_cast<void *>(create_info.pNext);
+            create_info.pNext = &present_id_features;
+            extensions.insert(
+                extensions.end(), present_wait_extensions.begin(), present_wait_extensions.end()
+            );
+        }
+
+        // TN_DYNAMIC_RENDERING=0 keeps the render pass and framebuffer path on devices that
+        // support dynamic rendering.
+        VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2_features{};
+        synchronization2_features.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+        VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamic_rendering_features{};
+        dynamic_rendering_features.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+        dynamic_rendering_features.pNext = &synchronization2_features;
+
+        const char *dynamic_rendering = getenv("TN_DYNAMIC_RENDERING");
+        if ((!dynamic_rendering || strcmp(dynamic_rendering, "0") != 0)
+            && device_props.apiVersion >= VK_API_VERSION_1_1
+            && Renderer::check_device_extension_support(
+                this->physical_device, dynamic_rendering_extensions
+            )) {
+            VkPhysicalDeviceFeatures2 features{};
+            features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features.pNext = &dynamic_rendering_features;
+            vkGetPhysicalDeviceFeatures2(this->physical_device, &features);
+
+            this->dynamic_rendering_supported = dynamic_rendering_features.dynamicRendering
+                                                && synchronization2_features.synchronization2;
+        }
+        if (this->dynamic_rendering_supported) {
+            synchronization2_features.pNext = const_cast<void *>(create_info.pNext);
+            create_info.pNext = &dynamic_rendering_features;
+            extensions.insert(
+                extensions.end(), dynamic_rendering_extensions.begin(),
+                dynamic_rendering_extensions.end()
+            );
+        }
+
+        create_info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+        create_info.ppEnabledExtensionNames = extensions.data();
 
         VkResult res =
             vkCreateDevice(this->physical_device, &create_info, nullptr, &(this->device));
         if (res == VK_SUCCESS) {
             std::cout << "Successfully created logical device." << std::endl;
-            vkGetDeviceQueue(this->device, indices.graphics_family, 0, &(this->graphics_queue));
+            vkGetDeviceQueue(this->device, this->graphics_family, 0, &(this->graphics_queue));
+            vkGetDeviceQueue(this->device, this->compute_family, 0, &(this->compute_queue));
+            vkGetDeviceQueue(this->device, this->present_family, 0, &(this->present_queue));
+            vkGetDeviceQueue(
+                this->device, this->transfer_family, transfer_queue_index, &(this->transfer_queue)
+            );
+
+            if (this->draw_indirect_count_supported) {
+                this->cmd_draw_indexed_indirect_count =
+                    reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+                        vkGetDeviceProcAddr(this->device, "vkCmdDrawIndexedIndirectCountKHR")
+                    );
+                this->draw_indirect_count_supported = this->cmd_draw_indexed_indirect_count;
+            }
+
+            if (this->present_wait_supported) {
+                this->wait_for_present = reinterpret_cast<PFN_vkWaitForPresentKHR>(
+                    vkGetDeviceProcAddr(this->device, "vkWaitForPresentKHR")
+                );
+                this->present_wait_supported = this->wait_for_present;
+            }
+
+            if (this->dynamic_rendering_supported) {
+                this->cmd_begin_rendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(
+                    vkGetDeviceProcAddr(this->device, "vkCmdBeginRenderingKHR")
+                );
+                this->cmd_end_rendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(
+                    vkGetDeviceProcAddr(this->device, "vkCmdEndRenderingKHR")
+                );
+                this->cmd_pipeline_barrier2 = reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(
+                    vkGetDeviceProcAddr(this->device, "vkCmdPipelineBarrier2KHR")
+                );
+                this->dynamic_rendering_supported = this->cmd_begin_rendering
+                                                    && this->cmd_end_rendering
+                                                    && this->cmd_pipeline_barrier2;
+            }
         }
     }
 
+    void Renderer::create_allocator() {
+        this->allocator.init(this->physical_device, this->device);
+    }
+
+    void Renderer::create_pipeline_cache() {
+        const char *path = getenv("TN_PIPELINE_CACHE");
+
+        this->pipeline_cache.create(
+            this->physical_device, this->device, path ? path : default_pipeline_cache_path
+        );
+    }
+
     void Renderer::create_surface(const Window &window) {
+#if defined(TN_PLATFORM_WIN32)
         VkWin32SurfaceCreateInfoKHR create_info{};
         create_info.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
         create_info.hinstance = window.get_instance();
@@ -394,6 +1728,14 @@ namespace TANELORN_ENGINE_NAMESPACE {
 
         VkResult res =
             vkCreateWin32SurfaceKHR(this->instance, &create_info, nullptr, &this->surface);
+#elif defined(TN_PLATFORM_XCB)
+        VkXcbSurfaceCreateInfoKHR create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR;
+        create_info.connection = window.get_connection();
+        create_info.window = window.get_raw_handle();
+
+        VkResult res = vkCreateXcbSurfaceKHR(this->instance, &create_info, nullptr, &this->surface);
+#endif
 
         if (res == VK_SUCCESS) {
             std::cout << "Successfully created surface." << std::endl;
@@ -402,12 +1744,13 @@ namespace TANELORN_ENGINE_NAMESPACE {
         }
     }
 
-    void Renderer::create_swapchain(const Window &window) {
+    void Renderer::create_swapchain(const Window &window, VkSwapchainKHR old_swapchain) {
         SwapchainSupportDetails swapchain_support =
             query_swapchain_support(this->physical_device, this->surface);
 
         VkSurfaceFormatKHR surface_format = choose_surface_format(swapchain_support.formats);
-        VkPresentModeKHR present_mode = choose_present_mode(swapchain_support.present_modes);
+        VkPresentModeKHR present_mode =
+            choose_present_mode(swapchain_support.present_modes, this->policy);
         VkExtent2D extent = this->choose_extent(swapchain_support.capabilities, window);
 
         uint32_t image_count = swapchain_support.capabilities.minImageCount + 1;
@@ -425,6 +1768,8 @@ namespace TANELORN_ENGINE_NAMESPACE {
         create_info.imageExtent = extent;
         create_info.imageArrayLayers = 1;
         create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        // Exclusive even with a separate present family: each frame hands its image over to the
+        // present queue explicitly, which is cheaper than concurrent sharing on every access.
         create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
         create_info.queueFamilyIndexCount = 0;
         create_info.pQueueFamilyIndices = nullptr;
@@ -432,11 +1777,12 @@ namespace TANELORN_ENGINE_NAMESPACE {
         create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
         create_info.presentMode = present_mode;
         create_info.clipped = VK_TRUE;
-        create_info.oldSwapchain = VK_NULL_HANDLE;
+        create_info.oldSwapchain = old_swapchain;
 
         VkResult res = vkCreateSwapchainKHR(this->device, &create_info, nullptr, &this->swapchain);
         if (res == VK_SUCCESS) {
-            std::cout << "Successfully created swapchain." << std::endl;
+            std::cout << "Successfully created swapchain with present mode " << present_mode
+                      << '.' << std::endl;
 
             uint32_t swapchain_image_count;
             vkGetSwapchainImagesKHR(this->device, this->swapchain, &swapchain_image_count, nullptr);
@@ -447,6 +1793,7 @@ namespace TANELORN_ENGINE_NAMESPACE {
 
             this->swapchain_image_format = surface_format.format;
             this->swapchain_extent = extent;
+            this->swapchain_window_size = window.framebuffer_size();
         }
     }
 
@@ -479,7 +1826,60 @@ namespace TANELORN_ENGINE_NAMESPACE {
         }
     }
 
+    void Renderer::create_offscreen_images() {
+        this->swapchain_images.resize(this->frames_in_flight);
+        this->offscreen_image_allocations.resize(this->frames_in_flight);
+
+        for (u32 i = 0; i < this->frames_in_flight; i++) {
+            VkImageCreateInfo create_info{};
+            create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            create_info.imageType = VK_IMAGE_TYPE_2D;
+            create_info.format = this->swapchain_image_format;
+            create_info.extent = {this->swapchain_extent.width, this->swapchain_extent.height, 1};
+            create_info.mipLevels = 1;
+            create_info.arrayLayers = 1;
+            create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+            create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+            create_info.usage =
+                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            if (this->allocator.create_image(
+                    create_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, this->swapchain_images[i],
+                    this->offscreen_image_allocations[i]
+                )) {
+                std::cout << "Successfully created offscreen image." << std::endl;
+            }
+        }
+    }
+
+    void Renderer::create_readback_buffer() {
+        this->readback_slot_size = static_cast<VkDeviceSize>(this->swapchain_extent.width)
+                                   * this->swapchain_extent.height * headless_bytes_per_pixel;
+
+        VkBufferCreateInfo create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        create_info.size = this->readback_slot_size * this->frames_in_flight;
+        create_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (this->allocator.create_buffer(
+                create_info,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                this->readback_buffer, this->readback_allocation
+            )) {
+            std::cout << "Successfully created readback buffer." << std::endl;
+        }
+    }
+
     void Renderer::create_render_pass() {
+        if (this->dynamic_rendering_supported) {
+            this->render_pass = VK_NULL_HANDLE;
+            std::cout << "Using dynamic rendering; no render pass or framebuffers." << std::endl;
+            return;
+        }
+
         VkAttachmentDescription color_attachment{};
         color_attachment.format = this->swapchain_image_format;
         color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -487,8 +1887,10 @@ namespace TANELORN_ENGINE_NAMESPACE {
         color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        // The render graph transitions the target around the pass and synchronizes it with
+        // the acquire, the readback copy and presentation.
+        color_attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
         VkAttachmentReference color_attachment_ref{};
         color_attachment_ref.attachment = 0;
@@ -499,22 +1901,14 @@ namespace TANELORN_ENGINE_NAMESPACE {
         subpass.colorAttachmentCount = 1;
         subpass.pColorAttachments = &color_attachment_ref;
 
-        VkSubpassDependency dependency{};
-        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        dependency.dstSubpass = 0;
-        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependency.srcAccessMask = 0;
-        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
         VkRenderPassCreateInfo create_info{};
         create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
         create_info.attachmentCount = 1;
         create_info.pAttachments = &color_attachment;
         create_info.subpassCount = 1;
         create_info.pSubpasses = &subpass;
-        create_info.dependencyCount = 1;
-        create_info.pDependencies = &dependency;
+        create_info.dependencyCount = 0;
+        create_info.pDependencies = nullptr;
 
         VkResult res = vkCreateRenderPass(this->device, &create_info, nullptr, &this->render_pass);
         if (res == VK_SUCCESS) {
@@ -522,122 +1916,27 @@ namespace TANELORN_ENGINE_NAMESPACE {
         }
     }
 
-    VkShaderModule Renderer::create_shader_module(const std::vector<char> &code) {
-        VkShaderModuleCreateInfo create_info{};
-        create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        create_info.codeSize = code.size();
-        create_info.pCode = reinterpret_cast<const uint32_t *>(code.data());
-
-        VkShaderModule shader_module;
-        VkResult res = vkCreateShaderModule(this->device, &create_info, nullptr, &shader_module);
-
-        if (res == VK_SUCCESS) {
-            std::cout << "Successfully created shader module." << std::endl;
-            return shader_module;
-        } else {
-            std::cout << "Failed to create shader module: " << res << '.' << std::endl;
-            return VK_NULL_HANDLE;
-        }
+    void Renderer::create_bindless_heap() {
+        this->bindless.init(this->physical_device, this->device);
     }
 
     void Renderer::create_graphics_pipeline() {
-        std::vector<char> vert_shader_code = read_spv("../shaders/vert.spv");
-        std::vector<char> frag_shader_code = read_spv("../shaders/frag.spv");
-
-        VkShaderModule vert_shader_module = this->create_shader_module(vert_shader_code);
-        VkShaderModule frag_shader_module = this->create_shader_module(frag_shader_code);
-
-        VkPipelineShaderStageCreateInfo vert_shader_stage_info{};
-        vert_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        vert_shader_stage_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
-        vert_shader_stage_info.module = vert_shader_module;
-        vert_shader_stage_info.pName = "main";
-
-        VkPipelineShaderStageCreateInfo frag_shader_stage_info{};
-        frag_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        frag_shader_stage_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        frag_shader_stage_info.module = frag_shader_module;
-        frag_shader_stage_info.pName = "main";
-
-        VkPipelineShaderStageCreateInfo shader_stages[2] = {
-            vert_shader_stage_info, frag_shader_stage_info};
-
-        std::vector<VkDynamicState> dynamic_states = {
-            VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
-
-        VkPipelineDynamicStateCreateInfo dynamic_state{};
-        dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-        dynamic_state.dynamicStateCount = static_cast<uint32_t>(dynamic_states.size());
-        dynamic_state.pDynamicStates = dynamic_states.data();
-
-        VkPipelineVertexInputStateCreateInfo vertex_input_state{};
-        vertex_input_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertex_input_state.vertexBindingDescriptionCount = 0;
-        vertex_input_state.pVertexBindingDescriptions = nullptr;
-        vertex_input_state.vertexAttributeDescriptionCount = 0;
-        vertex_input_state.pVertexAttributeDescriptions = nullptr;
-
-        VkPipelineInputAssemblyStateCreateInfo input_assembly{};
-        input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-        input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-        input_assembly.primitiveRestartEnable = VK_FALSE;
-
-        VkPipelineViewportStateCreateInfo viewport_state{};
-        viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-        viewport_state.viewportCount = 1;
-        viewport_state.scissorCount = 1;
-
-        VkPipelineRasterizationStateCreateInfo rasterizer{};
-        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-        rasterizer.depthClampEnable = VK_FALSE;
-        rasterizer.rasterizerDiscardEnable = VK_FALSE;
-        rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-        rasterizer.lineWidth = 1.0f;
-        rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-        rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-        rasterizer.depthBiasEnable = VK_FALSE;
-        rasterizer.depthBiasConstantFactor = 0.0f;
-        rasterizer.depthBiasClamp = 0.0f;
-        rasterizer.depthBiasSlopeFactor = 0.0f;
-
-        VkPipelineMultisampleStateCreateInfo multisampling{};
-        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-        multisampling.sampleShadingEnable = VK_FALSE;
-        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-        multisampling.minSampleShading = 1.0f;
-        multisampling.pSampleMask = nullptr;
-        multisampling.alphaToCoverageEnable = VK_FALSE;
-        multisampling.alphaToOneEnable = VK_FALSE;
-
-        VkPipelineColorBlendAttachmentState color_blend_attachment{};
-        color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
-                                                | VK_COLOR_COMPONENT_B_BIT
-                                                | VK_COLOR_COMPONENT_A_BIT;
-        color_blend_attachment.blendEnable = VK_FALSE;
-        color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-        color_blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-        color_blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
-        color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-        color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-        color_blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
-
-        VkPipelineColorBlendStateCreateInfo color_blending{};
-        color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-        color_blending.logicOpEnable = VK_FALSE;
-        color_blending.logicOp = VK_LOGIC_OP_COPY;
-        color_blending.attachmentCount = 1;
-        color_blending.pAttachments = &color_blend_attachment;
-        color_blending.blendConstants[0] = 0.0f;
-        color_blending.blendConstants[1] = 0.0f;
-        color_blending.blendConstants[2] = 0.0f;
-        color_blending.blendConstants[3] = 0.0f;
+        const char *shader_directory = getenv("TN_SHADER_DIR");
+        this->shader_directory = shader_directory ? shader_directory : TN_SHADER_SOURCE_DIR;
+
+        VkDescriptorSetLayout set_layout = this->bindless.layout();
+
+        VkPushConstantRange push_constant_range{};
+        push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        push_constant_range.offset = 0;
+        push_constant_range.size = sizeof(DrawConstants);
 
         VkPipelineLayoutCreateInfo pipeline_layout_create_info{};
         pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipeline_layout_create_info.setLayoutCount = 0;
-        pipeline_layout_create_info.pSetLayouts = nullptr;
-        pipeline_layout_create_info.pushConstantRangeCount = 0;
-        pipeline_layout_create_info.pPushConstantRanges = nullptr;
+        pipeline_layout_create_info.setLayoutCount = 1;
+        pipeline_layout_create_info.pSetLayouts = &set_layout;
+        pipeline_layout_create_info.pushConstantRangeCount = 1;
+        pipeline_layout_create_info.pPushConstantRanges = &push_constant_range;
 
         if (vkCreatePipelineLayout(
                 this->device, &pipeline_layout_create_info, nullptr, &this->pipeline_layout
@@ -646,38 +1945,96 @@ namespace TANELORN_ENGINE_NAMESPACE {
             std::cout << "Successfully created pipeline layout." << std::endl;
         }
 
-        VkGraphicsPipelineCreateInfo create_info{};
-        create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        create_info.stageCount = 2;
-        create_info.pStages = shader_stages;
-        create_info.pVertexInputState = &vertex_input_state;
-        create_info.pInputAssemblyState = &input_assembly;
-        create_info.pTessellationState = nullptr;
-        create_info.pViewportState = &viewport_state;
-        create_info.pRasterizationState = &rasterizer;
-        create_info.pMultisampleState = &multisampling;
-        create_info.pDepthStencilState = nullptr;
-        create_info.pColorBlendState = &color_blending;
-        create_info.pDynamicState = &dynamic_state;
-        create_info.layout = this->pipeline_layout;
-        create_info.renderPass = this->render_pass;
-        create_info.subpass = 0;
-        create_info.basePipelineHandle = VK_NULL_HANDLE;
-        create_info.basePipelineIndex = -1;
-
-        VkResult res = vkCreateGraphicsPipelines(
-            this->device, VK_NULL_HANDLE, 1, &create_info, nullptr, &this->pipeline
+        PipelineTarget target{};
+        target.layout = this->pipeline_layout;
+        target.render_pass = this->render_pass;
+        target.color_format = this->swapchain_image_format;
+        this->pipelines.init(this->device, this->pipeline_cache, target);
+
+        if (shader_directory) {
+            this->pipelines.set_shaders(this->pipelines.create_shaders(
+                SpirvCode::map_file(this->shader_directory + "/vert.spv"),
+                SpirvCode::map_file(this->shader_directory + "/frag.spv")
+            ));
+        } else {
+            this->pipelines.set_shaders(this->pipelines.create_shaders(
+                embedded_spirv("shader.vert"), embedded_spirv("shader.frag")
+            ));
+        }
+
+        // The first variant requested gets DEFAULT_PIPELINE.
+        this->pipelines.request(PipelineDesc::defaults());
+        this->pipelines.build_pending(this->jobs);
+    }
+
+    void Renderer::enable_shader_hot_reload() {
+        std::vector<ShaderSource> shaders = {
+            ShaderSource{"shader.vert", "vert.spv"}, ShaderSource{"shader.frag", "frag.spv"}};
+
+        // With TN_SHADER_DIR the SPIR-V lives next to the sources, where the pipelines were
+        // built from; otherwise it goes to the build tree, never into the source checkout.
+        bool custom_directory = getenv("TN_SHADER_DIR");
+        this->shader_manager.init(
+            this->shader_directory,
+            custom_directory ? this->shader_directory : TN_SHADER_BINARY_DIR, shaders,
+            [this](const std::vector<SpirvCode> &code) {
+                PipelineSet set{};
+                set.shaders = this->pipelines.create_shaders(code[0], code[1]);
+                if (!this->pipelines.build_set(set)) {
+                    this->pipelines.destroy_set(set);
+                    return;
+                }
+
+                // A reload that was never picked up is superseded; no frame has used it.
+                std::lock_guard<std::mutex> lock(this->reloaded_pipeline_mutex);
+                this->pipelines.destroy_set(this->reloaded_pipelines);
+                this->reloaded_pipelines = set;
+            }
         );
+    }
 
-        if (res == VK_SUCCESS) {
-            std::cout << "Successfully created pipeline." << std::endl;
+    void Renderer::swap_reloaded_pipelines() {
+        PipelineSet set;
+        {
+            std::lock_guard<std::mutex> lock(this->reloaded_pipeline_mutex);
+            set = this->reloaded_pipelines;
+            this->reloaded_pipelines = PipelineSet{};
+        }
+
+        if (set.shaders.vertex == VK_NULL_HANDLE) {
+            return;
+        }
+
+        std::vector<VkPipeline> retired;
+        this->pipelines.swap_set(set, retired);
+        for (VkPipeline pipeline : retired) {
+            this->retired_pipelines.push_back(
+                RetiredPipeline{pipeline, this->graphics_timeline.last_submitted()}
+            );
         }
+        std::cout << "Reloaded shaders." << std::endl;
+    }
+
+    void Renderer::destroy_retired_pipelines(bool all) {
+        while (!this->retired_pipelines.empty()) {
+            const RetiredPipeline &retired = this->retired_pipelines.front();
+
+            // Frames recorded before the swap are complete once the graphics timeline has
+            // passed the last of them.
+            if (!all && !this->graphics_timeline.is_complete(retired.retire_frame)) {
+                return;
+            }
 
-        vkDestroyShaderModule(this->device, frag_shader_module, nullptr);
-        vkDestroyShaderModule(this->device, vert_shader_module, nullptr);
+            vkDestroyPipeline(this->device, retired.pipeline, nullptr);
+            this->retired_pipelines.pop_front();
+        }
     }
 
     void Renderer::create_framebuffers() {
+        if (this->dynamic_rendering_supported) {
+            return;
+        }
+
         this->framebuffers.resize(this->swapchain_image_views.size());
 
         for (usize i = 0; i < this->swapchain_image_views.size(); i++) {
@@ -703,12 +2060,10 @@ namespace TANELORN_ENGINE_NAMESPACE {
     }
 
     void Renderer::create_command_pool() {
-        QueueFamilyIndices indices = find_queue_families(this->physical_device);
-
         VkCommandPoolCreateInfo create_info{};
         create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
         create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-        create_info.queueFamilyIndex = indices.graphics_family;
+        create_info.queueFamilyIndex = this->graphics_family;
 
         VkResult res =
             vkCreateCommandPool(this->device, &create_info, nullptr, &this->command_pool);
@@ -718,61 +2073,506 @@ namespace TANELORN_ENGINE_NAMESPACE {
         }
     }
 
-    void Renderer::create_command_buffer() {
+    void Renderer::create_command_buffers() {
+        this->command_buffers.resize(this->frames_in_flight);
+
         VkCommandBufferAllocateInfo alloc_info{};
         alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         alloc_info.commandPool = this->command_pool;
         alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        alloc_info.commandBufferCount = 1;
+        alloc_info.commandBufferCount = static_cast<uint32_t>(this->command_buffers.size());
 
-        VkResult res = vkAllocateCommandBuffers(this->device, &alloc_info, &this->command_buffer);
+        VkResult res =
+            vkAllocateCommandBuffers(this->device, &alloc_info, this->command_buffers.data());
 
         if (res == VK_SUCCESS) {
-            std::cout << "Successfully created command buffer." << std::endl;
+            std::cout << "Successfully created " << this->command_buffers.size()
+                      << " command buffers." << std::endl;
+        }
+    }
+
+    void Renderer::create_worker_command_pools() {
+        u32 worker_count = std::thread::hardware_concurrency();
+        worker_count = std::max(1u, std::min(worker_count, max_record_workers));
+        this->jobs.init(worker_count);
+
+        usize pool_count = static_cast<usize>(this->frames_in_flight) * worker_count;
+        this->worker_command_pools.resize(pool_count);
+        this->worker_command_buffers.resize(pool_count);
+        this->worker_command_buffers_used.resize(pool_count, 0);
+
+        // Transient pools without RESET_COMMAND_BUFFER_BIT: individual buffers are never reset,
+        // which lets the driver recycle the whole pool's memory in one go.
+        VkCommandPoolCreateInfo create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        create_info.queueFamilyIndex = this->graphics_family;
+
+        for (VkCommandPool &pool : this->worker_command_pools) {
+            VkResult res = vkCreateCommandPool(this->device, &create_info, nullptr, &pool);
+            if (res != VK_SUCCESS) {
+                std::cout << "Failed to create worker command pool: " << res << std::endl;
+                return;
+            }
+        }
+
+        std::cout << "Successfully created " << pool_count << " worker command pools."
+                  << std::endl;
+    }
+
+    void Renderer::create_profiler() {
+        this->profiler.init(
+            this->physical_device, this->device, this->graphics_family, this->frames_in_flight,
+            this->pipeline_statistics_supported
+        );
+    }
+
+    void Renderer::create_render_graph() {
+        this->graph.init(this->device, this->allocator, this->cmd_pipeline_barrier2);
+
+        // Swapchain images arrive undefined in the stage the acquire semaphore is waited on;
+        // their previous contents are cleared anyway.
+        this->graph_target = this->graph.import_image(
+            "target", VK_IMAGE_ASPECT_COLOR_BIT,
+            ResourceState{
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED}
+        );
+
+        u32 main_pass = this->graph.add_pass("main pass", [this](VkCommandBuffer command_buffer) {
+            this->profiler.write_begin(command_buffer, this->main_pass_scope);
+            this->profiler.begin_statistics(command_buffer);
+
+            VkClearValue clear_color = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+            VkRect2D render_area = {{0, 0}, this->swapchain_extent};
+
+            if (this->dynamic_rendering_supported) {
+                VkRenderingAttachmentInfoKHR color_attachment{};
+                color_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+                color_attachment.imageView = this->swapchain_image_views[this->graph_image_index];
+                color_attachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+                color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+                color_attachment.clearValue = clear_color;
+
+                VkRenderingInfoKHR rendering_info{};
+                rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+                rendering_info.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR;
+                rendering_info.renderArea = render_area;
+                rendering_info.layerCount = 1;
+                rendering_info.colorAttachmentCount = 1;
+                rendering_info.pColorAttachments = &color_attachment;
+
+                this->cmd_begin_rendering(command_buffer, &rendering_info);
+            } else {
+                VkRenderPassBeginInfo render_pass_info{};
+                render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                render_pass_info.renderPass = this->render_pass;
+                render_pass_info.framebuffer = this->framebuffers[this->graph_image_index];
+                render_pass_info.renderArea = render_area;
+                render_pass_info.clearValueCount = 1;
+                render_pass_info.pClearValues = &clear_color;
+
+                vkCmdBeginRenderPass(
+                    command_buffer, &render_pass_info,
+                    VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                );
+            }
+
+            vkCmdExecuteCommands(
+                command_buffer, static_cast<uint32_t>(this->main_pass_secondaries.size()),
+                this->main_pass_secondaries.data()
+            );
+
+            if (this->dynamic_rendering_supported) {
+                this->cmd_end_rendering(command_buffer);
+            } else {
+                vkCmdEndRenderPass(command_buffer);
+            }
+
+            this->profiler.end_statistics(command_buffer);
+            this->profiler.write_end(command_buffer, this->main_pass_scope);
+        });
+        this->graph.write(main_pass, this->graph_target, ResourceAccess::ColorAttachmentWrite);
+
+        if (this->headless) {
+            this->graph_readback = this->graph.import_buffer(
+                "readback", ResourceState{0, 0, VK_IMAGE_LAYOUT_UNDEFINED}
+            );
+
+            u32 readback_pass =
+                this->graph.add_pass("readback", [this](VkCommandBuffer command_buffer) {
+                    VkBufferImageCopy region{};
+                    region.bufferOffset = this->graph_image_index * this->readback_slot_size;
+                    region.bufferRowLength = 0;
+                    region.bufferImageHeight = 0;
+                    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                    region.imageSubresource.mipLevel = 0;
+                    region.imageSubresource.baseArrayLayer = 0;
+                    region.imageSubresource.layerCount = 1;
+                    region.imageOffset = {0, 0, 0};
+                    region.imageExtent = {
+                        this->swapchain_extent.width, this->swapchain_extent.height, 1};
+
+                    vkCmdCopyImageToBuffer(
+                        command_buffer, this->swapchain_images[this->graph_image_index],
+                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, this->readback_buffer, 1, &region
+                    );
+                });
+            this->graph.bind_buffer(this->graph_readback, this->readback_buffer);
+            this->graph.read(readback_pass, this->graph_target, ResourceAccess::TransferRead);
+            this->graph.write(readback_pass, this->graph_readback, ResourceAccess::TransferWrite);
+            this->graph.export_resource(
+                this->graph_readback,
+                ResourceState{VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT,
+                              VK_IMAGE_LAYOUT_UNDEFINED}
+            );
+        } else {
+            // With a separate present family the transition to the present layout doubles as
+            // the release of the image, acquired by `submit_present_acquire`. The image comes
+            // back undefined from the next acquire, so it never needs to be released back.
+            bool transfer = this->present_family != this->graphics_family;
+            this->graph.export_resource(
+                this->graph_target,
+                ResourceState{
+                    VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR},
+                transfer ? this->graphics_family : VK_QUEUE_FAMILY_IGNORED,
+                transfer ? this->present_family : VK_QUEUE_FAMILY_IGNORED
+            );
         }
+
+        this->graph.compile();
+        std::cout << "Successfully created render graph." << std::endl;
+#ifndef TN_RELEASE
+        this->graph.print_schedule();
+#endif
     }
 
     void Renderer::create_sync_objects() {
         VkSemaphoreCreateInfo semaphore_info{};
         semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-        VkFenceCreateInfo fence_info{};
-        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        this->image_available_semaphores.resize(this->frames_in_flight);
+        // Value 0 is reached from the start, so every slot begins complete.
+        this->frame_values.resize(this->frames_in_flight, 0);
+        this->frame_start_times.resize(this->frames_in_flight);
+        this->graphics_timeline.init(this->device, this->graphics_queue);
+
+        bool success = true;
+        for (u32 i = 0; i < this->frames_in_flight; i++) {
+            success = success
+                      && vkCreateSemaphore(
+                             this->device, &semaphore_info, nullptr,
+                             &this->image_available_semaphores[i]
+                         ) == VK_SUCCESS;
+        }
+        this->create_render_finished_semaphores();
+
+        if (success) {
+            std::cout << "Successfully created sync objects for " << this->frames_in_flight
+                      << " frames in flight." << std::endl;
+        }
+    }
+
+    void Renderer::create_render_finished_semaphores() {
+        VkSemaphoreCreateInfo semaphore_info{};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        this->render_finished_semaphores.resize(this->swapchain_images.size());
+        for (VkSemaphore &semaphore : this->render_finished_semaphores) {
+            VkResult res = vkCreateSemaphore(this->device, &semaphore_info, nullptr, &semaphore);
+            if (res != VK_SUCCESS) {
+                std::cout << "Failed to create render finished semaphore: " << res << std::endl;
+            }
+        }
+
+        if (this->present_family == this->graphics_family) {
+            return;
+        }
+        this->present_ready_semaphores.resize(this->swapchain_images.size());
+        for (VkSemaphore &semaphore : this->present_ready_semaphores) {
+            VkResult res = vkCreateSemaphore(this->device, &semaphore_info, nullptr, &semaphore);
+            if (res != VK_SUCCESS) {
+                std::cout << "Failed to create present ready semaphore: " << res << std::endl;
+            }
+        }
+    }
+
+    void Renderer::create_present_transfer() {
+        if (this->present_family == this->graphics_family) {
+            return;
+        }
+
+        this->present_timeline.init(this->device, this->present_queue);
+        this->present_values.assign(this->frames_in_flight, 0);
+
+        VkCommandPoolCreateInfo pool_info{};
+        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        pool_info.queueFamilyIndex = this->present_family;
+        vkCreateCommandPool(this->device, &pool_info, nullptr, &this->present_command_pool);
+
+        this->present_command_buffers.resize(this->frames_in_flight);
+        VkCommandBufferAllocateInfo alloc_info{};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool = this->present_command_pool;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandBufferCount = this->frames_in_flight;
+        VkResult res = vkAllocateCommandBuffers(
+            this->device, &alloc_info, this->present_command_buffers.data()
+        );
+
+        if (res == VK_SUCCESS) {
+            std::cout << "Successfully created present transfer from queue family "
+                      << this->graphics_family << " to " << this->present_family << '.'
+                      << std::endl;
+        } else {
+            std::cout << "Failed to create present command buffers: " << res << std::endl;
+        }
+    }
+
+    void Renderer::submit_present_acquire(VkSemaphore render_finished, VkSemaphore present_ready) {
+        u32 slot = this->current_frame;
+        this->present_timeline.wait(this->present_values[slot]);
+
+        VkCommandBuffer command_buffer = this->present_command_buffers[slot];
+        vkResetCommandBuffer(command_buffer, 0);
+
+        VkCommandBufferBeginInfo begin_info{};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(command_buffer, &begin_info);
+
+        // Must match the release the render graph recorded as its exit barrier, layouts included.
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = 0;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        barrier.srcQueueFamilyIndex = this->graphics_family;
+        barrier.dstQueueFamilyIndex = this->present_family;
+        barrier.image = this->swapchain_images[this->graph_image_index];
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        vkCmdPipelineBarrier(
+            command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier
+        );
+        vkEndCommandBuffer(command_buffer);
+
+        this->present_timeline.add_wait(render_finished, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+        this->present_timeline.add_command_buffer(command_buffer);
+        this->present_timeline.add_signal(present_ready);
+        this->present_values[slot] = this->present_timeline.submit();
+    }
+
+    bool Renderer::recreate_swapchain() {
+        FramebufferSize size = this->window->framebuffer_size();
+        if (size.width <= 0 || size.height <= 0) {
+            return false;
+        }
+
+        // Frames already submitted keep rendering into and presenting from the old swapchain,
+        // so its resources are retired here and destroyed once those frames have completed.
+        RetiredSwapchain retired{};
+        retired.swapchain = this->swapchain;
+        retired.image_views = std::move(this->swapchain_image_views);
+        retired.framebuffers = std::move(this->framebuffers);
+        retired.render_finished_semaphores = std::move(this->render_finished_semaphores);
+        retired.present_ready_semaphores = std::move(this->present_ready_semaphores);
+        retired.retire_frame = this->graphics_timeline.last_submitted();
+        retired.retire_present = this->present_timeline.last_submitted();
+        this->first_present_id = this->submitted_frames + 1;
+        this->retired_swapchains.push_back(std::move(retired));
+
+        this->swapchain_image_views.clear();
+        this->framebuffers.clear();
+        this->render_finished_semaphores.clear();
+        this->present_ready_semaphores.clear();
+
+        this->create_swapchain(*this->window, this->retired_swapchains.back().swapchain);
+        this->create_image_views();
+        this->create_framebuffers();
+        this->create_render_finished_semaphores();
+
+        std::cout << "Recreated swapchain at " << this->swapchain_extent.width << 'x'
+                  << this->swapchain_extent.height << '.' << std::endl;
+
+        return true;
+    }
+
+    void Renderer::destroy_retired_swapchains(bool all) {
+        while (!this->retired_swapchains.empty()) {
+            RetiredSwapchain &retired = this->retired_swapchains.front();
+
+            // Presentation signals nothing, so one more frame finishing on the GPU is the margin
+            // for the last present to the old swapchain.
+            if (!all
+                && (!this->graphics_timeline.is_complete(retired.retire_frame + 1)
+                    || !this->present_timeline.is_complete(retired.retire_present))) {
+                return;
+            }
+
+            for (const VkFramebuffer &framebuffer : retired.framebuffers) {
+                vkDestroyFramebuffer(this->device, framebuffer, nullptr);
+            }
+            for (const VkImageView &image_view : retired.image_views) {
+                vkDestroyImageView(this->device, image_view, nullptr);
+            }
+            for (const VkSemaphore &semaphore : retired.render_finished_semaphores) {
+                vkDestroySemaphore(this->device, semaphore, nullptr);
+            }
+            for (const VkSemaphore &semaphore : retired.present_ready_semaphores) {
+                vkDestroySemaphore(this->device, semaphore, nullptr);
+            }
+            vkDestroySwapchainKHR(this->device, retired.swapchain, nullptr);
 
-        if (vkCreateSemaphore(
-                this->device, &semaphore_info, nullptr, &this->image_available_semaphore
-            ) == VK_SUCCESS
-            && vkCreateSemaphore(
-                   this->device, &semaphore_info, nullptr, &this->render_finished_semaphore
-               ) == VK_SUCCESS
-            && vkCreateFence(this->device, &fence_info, nullptr, &this->in_flight_fence)
-                   == VK_SUCCESS) {
-            std::cout << "Successfully created sync objects." << std::endl;
+            this->retired_swapchains.pop_front();
         }
     }
 
-    void Renderer::record_command_buffer(uint32_t image_index) {
+    void Renderer::record_command_buffer(VkCommandBuffer command_buffer, uint32_t image_index) {
+        TN_PROFILE_SCOPE("Renderer::record_command_buffer");
+
+        // Pick up a pipeline rebuilt by the shader watcher before any draw is recorded.
+        this->destroy_retired_pipelines(false);
+        this->swap_reloaded_pipelines();
+        // Variants requested since the last frame are built before any draw can use them.
+        this->pipelines.build_pending(this->jobs);
+
+        // Everything uploaded since the last frame goes out in one transfer submission. The
+        // uploader is not thread safe, so readiness is resolved here before recording fans out.
+        // Instead of skipping data still in flight, this submission waits on the transfer
+        // timeline on the GPU, right before the stages that read it. The buffers are shared
+        // concurrently, so no ownership transfer is needed.
+        this->uploader.flush();
+        u64 upload_value = 0;
+        this->draw_list.clear();
+        for (u32 i = 0; i < this->instance_batches.size(); i++) {
+            const InstanceBatch &batch = this->instance_batches[i];
+            u64 mesh_upload = this->meshes[batch.mesh].upload_id;
+            if (this->uploader.is_submitted(batch.upload_id)
+                && this->uploader.is_submitted(mesh_upload)) {
+                this->draw_list.push_back(i);
+                upload_value = std::max({upload_value, batch.upload_id, mesh_upload});
+            }
+        }
+        this->graphics_timeline.add_wait(
+            this->uploader.timeline(), upload_value,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+                | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+        );
+
+        // This slot's last frame has completed, so nothing recorded from its pools is pending.
+        u32 worker_count = this->jobs.worker_count();
+        u32 first_pool = this->current_frame * worker_count;
+        for (u32 worker = 0; worker < worker_count; worker++) {
+            vkResetCommandPool(this->device, this->worker_command_pools[first_pool + worker], 0);
+            this->worker_command_buffers_used[first_pool + worker] = 0;
+        }
+
+        u32 draw_count = static_cast<u32>(this->draw_list.size());
+
+        this->write_frame_constants();
+
+        // Visibility is decided on the GPU alone: the culling dispatches compact each batch's
+        // visible instances into the indirect draw the main pass then consumes.
+        this->record_culling(upload_value);
+
+        // The frame's dispatches go out first; graphics waits for them right before the
+        // stages that read their results, so they overlap with the previous frame's work. On a
+        // shared queue they join this frame's submission instead and nothing is waited for.
+        u64 compute_value = this->submit_compute();
+        this->graphics_timeline.add_wait(
+            this->compute.timeline(), compute_value, compute_consumer_stages
+        );
+        bool owns_compute_buffers = compute_value != 0 && this->compute.stats().async;
+
+        // Scopes are reserved here, on one thread; workers only write their timestamps.
+        this->profiler.begin_frame(this->current_frame);
+        u32 frame_scope = this->profiler.add_scope("frame");
+        this->main_pass_scope = this->profiler.add_scope("main pass");
+        this->draw_scopes.resize(draw_count);
+        for (u32 i = 0; i < draw_count; i++) {
+            const InstanceBatch &batch = this->instance_batches[this->draw_list[i]];
+            this->draw_scopes[i] = this->profiler.add_scope(batch.scope_name);
+        }
+        u32 job_count = (draw_count + min_draws_per_record_job - 1) / min_draws_per_record_job;
+        job_count = std::max(1u, std::min(job_count, worker_count));
+        u32 draws_per_job = (draw_count + job_count - 1) / job_count;
+
+        VkCommandBufferInheritanceInfo inheritance_info{};
+        inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance_info.renderPass = this->render_pass;
+        inheritance_info.subpass = 0;
+        inheritance_info.framebuffer =
+            this->dynamic_rendering_supported ? VK_NULL_HANDLE : this->framebuffers[image_index];
+        inheritance_info.pipelineStatistics = this->profiler.statistics_flags();
+
+        VkCommandBufferInheritanceRenderingInfoKHR inheritance_rendering_info{};
+        inheritance_rendering_info.sType =
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+        inheritance_rendering_info.colorAttachmentCount = 1;
+        inheritance_rendering_info.pColorAttachmentFormats = &this->swapchain_image_format;
+        inheritance_rendering_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        if (this->dynamic_rendering_supported) {
+            inheritance_info.pNext = &inheritance_rendering_info;
+        }
+
+        this->main_pass_secondaries.resize(job_count);
+        this->jobs.run(job_count, [&](u32 job, u32 worker) {
+            TN_PROFILE_SCOPE("record secondary");
+            VkCommandBuffer secondary = this->acquire_secondary_command_buffer(worker);
+
+            VkCommandBufferBeginInfo begin_info{};
+            begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+                               | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+            begin_info.pInheritanceInfo = &inheritance_info;
+            vkBeginCommandBuffer(secondary, &begin_info);
+
+            u32 first = std::min(job * draws_per_job, draw_count);
+            this->record_draws(secondary, first, std::min(draws_per_job, draw_count - first));
+
+            vkEndCommandBuffer(secondary);
+            this->main_pass_secondaries[job] = secondary;
+        });
+
         VkCommandBufferBeginInfo begin_info{};
         begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
         begin_info.flags = 0;
         begin_info.pInheritanceInfo = nullptr;
 
-        VkResult res = vkBeginCommandBuffer(this->command_buffer, &begin_info);
+        VkResult res = vkBeginCommandBuffer(command_buffer, &begin_info);
+
+        this->profiler.reset_queries(command_buffer);
+        this->profiler.write_begin(command_buffer, frame_scope);
+
+        if (owns_compute_buffers) {
+            this->transfer_compute_buffers(command_buffer, true);
+        }
+
+        this->graph_image_index = image_index;
+        this->graph.bind_image(
+            this->graph_target, this->swapchain_images[image_index],
+            this->swapchain_image_views[image_index]
+        );
+        this->graph.execute(command_buffer);
+        this->record_culling_readback(command_buffer);
 
-        VkRenderPassBeginInfo render_pass_info{};
-        render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        render_pass_info.renderPass = this->render_pass;
-        render_pass_info.framebuffer = this->framebuffers[image_index];
-        render_pass_info.renderArea.offset = {0, 0};
-        render_pass_info.renderArea.extent = this->swapchain_extent;
+        if (owns_compute_buffers) {
+            this->transfer_compute_buffers(command_buffer, false);
+        }
 
-        VkClearValue clear_color = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-        render_pass_info.clearValueCount = 1;
-        render_pass_info.pClearValues = &clear_color;
+        this->profiler.write_end(command_buffer, frame_scope);
+        res = vkEndCommandBuffer(command_buffer);
+    }
 
-        vkCmdBeginRenderPass(this->command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(this->command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->pipeline);
+    void Renderer::record_draws(VkCommandBuffer command_buffer, u32 first, u32 count) const {
+        // Secondary command buffers inherit no state, so each one binds everything it uses.
 
         VkViewport viewport{};
         viewport.x = 0.0f;
@@ -781,16 +2581,104 @@ namespace TANELORN_ENGINE_NAMESPACE {
         viewport.height = static_cast<float>(this->swapchain_extent.height);
         viewport.minDepth = 0.0f;
         viewport.maxDepth = 1.0f;
-        vkCmdSetViewport(this->command_buffer, 0, 1, &viewport);
+        vkCmdSetViewport(command_buffer, 0, 1, &viewport);
 
         VkRect2D scissor{};
         scissor.offset = {0, 0};
         scissor.extent = this->swapchain_extent;
-        vkCmdSetScissor(this->command_buffer, 0, 1, &scissor);
-        vkCmdDraw(this->command_buffer, 3, 1, 0, 0);
-        vkCmdEndRenderPass(this->command_buffer);
+        vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+        // Every resource is reached through the bindless set, so it is bound once and draws
+        // only push the indices they use.
+        VkDescriptorSet bindless_set = this->bindless.set();
+        vkCmdBindDescriptorSets(
+            command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->pipeline_layout, 0, 1,
+            &bindless_set, 0, nullptr
+        );
+
+        VkPipeline bound_pipeline = VK_NULL_HANDLE;
+        for (u32 i = first; i < first + count; i++) {
+            const InstanceBatch &batch = this->instance_batches[this->draw_list[i]];
+            const Mesh &mesh = this->meshes[batch.mesh];
+
+            this->profiler.write_begin(command_buffer, this->draw_scopes[i]);
+
+            // A variant that failed to build draws with the default pipeline instead. If that
+            // failed too there is nothing to draw with, but the scope is still closed so the
+            // frame's timestamps stay readable.
+            VkPipeline pipeline = this->pipelines.pipeline(batch.pipeline);
+            if (pipeline == VK_NULL_HANDLE) {
+                pipeline = this->pipelines.pipeline(DEFAULT_PIPELINE);
+            }
+            if (pipeline == VK_NULL_HANDLE) {
+                this->profiler.write_end(command_buffer, this->draw_scopes[i]);
+                continue;
+            }
+            if (pipeline != bound_pipeline) {
+                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+                bound_pipeline = pipeline;
+            }
+
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(command_buffer, 0, 1, &mesh.vertex_buffer, &offset);
+            vkCmdBindIndexBuffer(command_buffer, mesh.index_buffer, 0, VK_INDEX_TYPE_UINT32);
+
+            DrawConstants constants{};
+            constants.instance_buffer = batch.instance_buffer_index;
+            constants.frame_buffer = this->frame_data_index;
+            constants.frame_constants = this->frame_constants_index;
+            constants.culled_draw_buffer = BindlessHeap::INVALID_INDEX;
+
+            // A culled batch draws the survivors the culling dispatches compacted this frame.
+            VkBuffer indirect_buffer = batch.indirect_buffer;
+            VkBuffer count_buffer = batch.count_buffer;
+            VkDeviceSize count_offset = 0;
+            if (this->culls(batch)) {
+                const ComputeBuffer &draws = this->compute_buffers[batch.culled_draws];
+                indirect_buffer = draws.buffers[this->current_frame];
+                count_buffer = indirect_buffer;
+                count_offset = offsetof(CulledDrawHeader, draw_count);
+                constants.culled_draw_buffer = draws.bindless_indices[this->current_frame];
+            }
+            vkCmdPushConstants(
+                command_buffer, this->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+                sizeof(constants), &constants
+            );
+
+            if (this->draw_indirect_count_supported) {
+                this->cmd_draw_indexed_indirect_count(
+                    command_buffer, indirect_buffer, 0, count_buffer, count_offset,
+                    batch.max_draw_count, sizeof(VkDrawIndexedIndirectCommand)
+                );
+            } else {
+                vkCmdDrawIndexedIndirect(
+                    command_buffer, indirect_buffer, 0, batch.max_draw_count,
+                    sizeof(VkDrawIndexedIndirectCommand)
+                );
+            }
+
+            this->profiler.write_end(command_buffer, this->draw_scopes[i]);
+        }
+    }
 
-        res = vkEndCommandBuffer(this->command_buffer);
+    VkCommandBuffer Renderer::acquire_secondary_command_buffer(u32 worker) {
+        u32 index = this->current_frame * this->jobs.worker_count() + worker;
+        std::vector<VkCommandBuffer> &buffers = this->worker_command_buffers[index];
+        u32 &used = this->worker_command_buffers_used[index];
+
+        if (used == buffers.size()) {
+            VkCommandBufferAllocateInfo alloc_info{};
+            alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            alloc_info.commandPool = this->worker_command_pools[index];
+            alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            alloc_info.commandBufferCount = 1;
+
+            VkCommandBuffer command_buffer;
+            vkAllocateCommandBuffers(this->device, &alloc_info, &command_buffer);
+            buffers.push_back(command_buffer);
+        }
+
+        return buffers[used++];
     }
 
     bool Renderer::are_validation_layers_supported() {
@@ -818,10 +2706,17 @@ namespace TANELORN_ENGINE_NAMESPACE {
         return true;
     }
 
-    std::vector<const char *> Renderer::get_required_instance_extensions() {
-        uint32_t extension_count;
-        std::vector<const char *> extensions{
-            VK_KHR_SURFACE_EXTENSION_NAME, VK_KHR_WIN32_SURFACE_EXTENSION_NAME};
+    std::vector<const char *> Renderer::get_required_instance_extensions(bool headless) {
+        std::vector<const char *> extensions{};
+
+        if (!headless) {
+            extensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+#if defined(TN_PLATFORM_WIN32)
+            extensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+#elif defined(TN_PLATFORM_XCB)
+            extensions.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
+#endif
+        }
 
         if (enable_validations) {
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -830,37 +2725,111 @@ namespace TANELORN_ENGINE_NAMESPACE {
         return extensions;
     }
 
-    bool Renderer::is_device_suitable(VkPhysicalDevice device) {
-        QueueFamilyIndices indices = find_queue_families(device);
+    std::vector<const char *> Renderer::get_required_device_extensions() const {
+        std::vector<const char *> extensions = required_extensions;
+        if (!this->headless) {
+            extensions.insert(extensions.end(), device_extensions.begin(), device_extensions.end());
+        }
 
-        VkPhysicalDeviceProperties props;
-        vkGetPhysicalDeviceProperties(device, &props);
+        return extensions;
+    }
+
+    i64 Renderer::rate_device(VkPhysicalDevice device, std::string &reason) {
+        QueueFamilyIndices indices = find_queue_families(device, this->surface);
+        if (!indices.is_complete()) {
+            reason = "no graphics queue";
+            return -1;
+        }
 
-        VkPhysicalDeviceFeatures features;
-        vkGetPhysicalDeviceFeatures(device, &features);
+        if (!Renderer::check_device_extension_support(
+                device, this->get_required_device_extensions()
+            )) {
+            reason = "missing required device extensions";
+            return -1;
+        }
+
+        if (!BindlessHeap::is_supported(device)) {
+            reason = "no descriptor indexing support for bindless resources";
+            return -1;
+        }
+
+        if (!QueueTimeline::is_supported(device)) {
+            reason = "no timeline semaphore support";
+            return -1;
+        }
 
-        bool extensions_supported = Renderer::check_device_extension_support(device);
+        // Headless rendering has no surface to validate.
+        if (!this->headless) {
+            if (!indices.present_family_found) {
+                reason = "no queue family can present to the window surface";
+                return -1;
+            }
 
-        bool swapchain_adequate = false;
-        if (extensions_supported) {
             SwapchainSupportDetails swapchain_support =
                 query_swapchain_support(device, this->surface);
-            swapchain_adequate =
-                !(swapchain_support.formats.empty() || swapchain_support.present_modes.empty());
+            if (swapchain_support.formats.empty() || swapchain_support.present_modes.empty()) {
+                reason = "cannot present to the window surface";
+                return -1;
+            }
+        }
+
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(device, &props);
+
+        // Device type dominates: the VRAM and queue terms below never add up to a full step.
+        i64 score = 0;
+        switch (props.deviceType) {
+            case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+                score = 4000;
+                break;
+            case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+                score = 3000;
+                break;
+            case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+                score = 2000;
+                break;
+            case VK_PHYSICAL_DEVICE_TYPE_CPU:
+                score = 1000;
+                break;
+            default:
+                break;
+        }
+
+        VkPhysicalDeviceMemoryProperties memory_props;
+        vkGetPhysicalDeviceMemoryProperties(device, &memory_props);
+        VkDeviceSize device_local_bytes = 0;
+        for (uint32_t i = 0; i < memory_props.memoryHeapCount; i++) {
+            if (memory_props.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+                device_local_bytes += memory_props.memoryHeaps[i].size;
+            }
+        }
+        // One point per 256 MiB of device-local memory.
+        score += std::min<i64>(static_cast<i64>(device_local_bytes >> 28), 800);
+
+        if (indices.transfer_family_found) {
+            score += 100;
+        }
+        if (indices.compute_family_found) {
+            score += 100;
+        }
+        // Presenting from another family costs an ownership transfer and a submission a frame.
+        if (!this->headless && indices.present_family == indices.graphics_family) {
+            score += 50;
         }
 
-        return props.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU && features.geometryShader
-               && indices.is_complete() && swapchain_adequate;
+        return score;
     }
 
-    bool Renderer::check_device_extension_support(VkPhysicalDevice device) {
+    bool Renderer::check_device_extension_support(
+        VkPhysicalDevice device, const std::vector<const char *> &extensions
+    ) {
         uint32_t extension_count = 0;
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
 
         std::vector<VkExtensionProperties> props(extension_count);
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, props.data());
 
-        for (const char *extension_name : device_extensions) {
+        for (const char *extension_name : extensions) {
             bool found = false;
 
             for (const VkExtensionProperties &prop : props) {
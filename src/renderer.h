@@ -3,15 +3,113 @@
 #include "defines.h"
 #include "window.h"
 
+#if defined(TN_PLATFORM_WIN32)
 #define VK_USE_PLATFORM_WIN32_KHR
+#elif defined(TN_PLATFORM_XCB)
+#define VK_USE_PLATFORM_XCB_KHR
+#endif
 #include <vulkan/vulkan.h>
 
+#include "allocator.h"
+#include "bindless.h"
+#include "compute.h"
+#include "frame_allocator.h"
+#include "gpu_profiler.h"
+#include "job_system.h"
+#include "mesh.h"
+#include "pipeline_cache.h"
+#include "pipeline_registry.h"
+#include "render_graph.h"
+#include "shader_manager.h"
+#include "timeline.h"
+#include "uploader.h"
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
 #include <vector>
 
 namespace TANELORN_ENGINE_NAMESPACE {
+    constexpr u32 DEFAULT_FRAMES_IN_FLIGHT = 2;
+    // Pipeline variant built from PipelineDesc::defaults().
+    constexpr u32 DEFAULT_PIPELINE = 0;
+
+    struct FrameStats {
+        u64 frame_count;
+        f64 last_frame_ms;
+        f64 min_frame_ms;
+        f64 max_frame_ms;
+        f64 total_frame_ms;
+
+        f64 average_frame_ms() const {
+            return this->frame_count > 0 ? this->total_frame_ms / this->frame_count : 0.0;
+        }
+    };
+
+    // Time from the start of a frame, where input is sampled, until its image was observed on
+    // screen. Without VK_KHR_present_wait the end point is GPU completion instead.
+    struct LatencyStats {
+        u64 sample_count;
+        f64 last_ms;
+        f64 max_ms;
+        f64 total_ms;
+
+        f64 average_ms() const {
+            return this->sample_count > 0 ? this->total_ms / this->sample_count : 0.0;
+        }
+    };
+
+    // Instances tested by GPU culling in the latest frame whose results came back, which lags
+    // the frame being recorded by up to the number of frames in flight.
+    struct CullingStats {
+        bool enabled;
+        u32 objects;
+        u32 visible;
+        u32 culled;
+        u64 total_culled;
+    };
+
+    // How finished frames are queued for display. Fifo never tears and paces to the refresh
+    // rate; FifoRelaxed tears only when a frame misses vblank; Mailbox replaces the queued
+    // image for lower latency; Immediate presents right away and may tear. A policy the
+    // surface does not support falls back to Fifo, which is always available.
+    enum class PresentPolicy {
+        Fifo,
+        FifoRelaxed,
+        Mailbox,
+        Immediate,
+    };
+
+    // Swapchain resources replaced by a recreation. They stay alive until every frame that
+    // could still reference them has retired.
+    struct RetiredSwapchain {
+        VkSwapchainKHR swapchain;
+        std::vector<VkImageView> image_views;
+        std::vector<VkFramebuffer> framebuffers;
+        std::vector<VkSemaphore> render_finished_semaphores;
+        std::vector<VkSemaphore> present_ready_semaphores;
+        // Graphics timeline value of the last frame submitted before the swapchain was replaced.
+        u64 retire_frame;
+        // Present timeline value of that frame's ownership acquire, if there is one.
+        u64 retire_present;
+    };
+
+    struct RetiredPipeline {
+        VkPipeline pipeline;
+        // Graphics timeline value of the last frame that may still use the pipeline.
+        u64 retire_frame;
+    };
+
     class Renderer {
     public:
-        explicit Renderer(const Window &window);
+        explicit Renderer(
+            const Window &window, u32 frames_in_flight = DEFAULT_FRAMES_IN_FLIGHT,
+            PresentPolicy present_policy = PresentPolicy::Mailbox
+        );
+        // Creates a headless renderer that draws into device-local offscreen images instead of a
+        // swapchain. No surface or window system is required.
+        explicit Renderer(VkExtent2D extent, u32 frames_in_flight = DEFAULT_FRAMES_IN_FLIGHT);
         ~Renderer();
 
         Renderer(const Renderer &) = delete;
@@ -20,56 +118,307 @@ namespace TANELORN_ENGINE_NAMESPACE {
         Renderer(Renderer &&);
         Renderer &operator=(Renderer &&);
 
+        // Blocks until the next frame may start: the frame limiter's deadline, the present of
+        // an earlier frame when VK_KHR_present_wait is available, and the slot's last frame. Call
+        // it before sampling input so input is as fresh as possible; `draw_frame` calls it
+        // itself otherwise.
+        void pace_frame();
         void draw_frame();
         void wait_idle();
 
+        // Recreates the swapchain with the new present mode. Takes effect on the next frame.
+        void set_present_policy(PresentPolicy policy);
+        PresentPolicy present_policy() const;
+        // Caps the frame rate on the CPU. 0 removes the cap.
+        void set_frame_limit(f64 frames_per_second);
+        bool present_wait_enabled() const;
+        // Recompiles shader.vert and shader.frag with glslc whenever they change on disk and
+        // rebuilds every pipeline variant in the background. The new variants are swapped in at
+        // the start of the next frame; a shader that fails to compile keeps the previous ones.
+        void enable_shader_hot_reload();
+
+        // Headless only. Renders one frame into the next offscreen image and schedules its copy
+        // into host memory. Returns the slot to pass to `read_image` once the pixels are needed.
+        u32 render_to_image();
+        // Headless only. Waits for the frame rendered into `slot` and copies its tightly packed
+        // RGBA8 pixels into `pixels`.
+        void read_image(u32 slot, std::vector<u8> &pixels);
+        VkExtent2D extent() const;
+
+        // Uploads the geometry through the staging ring on the transfer queue and returns a mesh
+        // id. The mesh is drawn from the next frame, whose submission waits for the upload on
+        // the GPU. Returns UINT32_MAX for empty geometry or when its buffers cannot be created.
+        u32 create_mesh(const std::vector<Vertex> &vertices, const std::vector<u32> &indices);
+        // Draws `instances` copies of `mesh` with one indirect draw, using the pipeline variant
+        // `pipeline` from `request_pipeline`. Instance data is read from a storage buffer
+        // indexed by gl_InstanceIndex. Returns UINT32_MAX for an invalid mesh, no instances, or
+        // when its buffers or bindless slots cannot be allocated.
+        u32 create_instance_batch(
+            u32 mesh, const std::vector<InstanceData> &instances, u32 pipeline = DEFAULT_PIPELINE
+        );
+        // Returns the id of the pipeline variant for `desc`. New variants are built in parallel
+        // before the next frame records; identical descriptions share one pipeline.
+        u32 request_pipeline(const PipelineDesc &desc);
+        // Builds every variant in `descs` now, spread over all recording workers, so the first
+        // frames using them do not stall.
+        void prewarm_pipelines(const std::vector<PipelineDesc> &descs);
+        const PipelineRegistryStats &pipeline_stats() const;
+        // Waits for the device to go idle, then releases every instance batch. Dispatches
+        // already recorded for the next frame are dropped.
+        void clear_instance_batches();
+        const UploadStats &upload_stats() const;
+        AllocatorStats memory_stats() const;
+        // Reserves `size` bytes of data for the next frame, valid until that frame has rendered.
+        // Paces the frame first, as its slot of the ring is only free after its last frame.
+        // Shaders reach the data through the bindless storage buffer `frame_data_slot()`.
+        FrameAllocation allocate_frame_data(VkDeviceSize size, VkDeviceSize alignment = 0);
+        u32 frame_data_slot() const;
+        const FrameAllocatorStats &frame_data_stats() const;
+        // Compute shaders reach resources through the bindless set and take up to
+        // COMPUTE_PUSH_CONSTANT_SIZE bytes of push constants. Returns UINT32_MAX on failure.
+        u32 create_compute_pipeline(const SpirvCode &code);
+        // Creates a storage buffer for dispatches to write and the same frame's draws to read,
+        // with one copy per frame in flight. `usage` adds to storage buffer usage, e.g. for
+        // indirect arguments.
+        u32 create_compute_buffer(VkDeviceSize size, VkBufferUsageFlags usage = 0);
+        // Bindless storage buffer slot of the next frame's copy of `buffer`.
+        u32 compute_buffer_slot(u32 buffer) const;
+        // Records a dispatch into the next frame's compute submission, which runs on the async
+        // compute queue when the device has one. That frame's draws wait for it on the GPU.
+        // Paces the frame first, as its command buffer is only free after its last frame.
+        void dispatch_compute(
+            u32 pipeline, u32 groups_x, u32 groups_y, u32 groups_z,
+            const void *push_constants = nullptr, u32 push_constant_size = 0
+        );
+        const ComputeStats &compute_stats() const;
+        // Culls every batch's instances against the viewport in a compute dispatch and draws
+        // only the survivors, compacted on the GPU. On by default; takes effect on the next
+        // frame.
+        void set_gpu_culling(bool enabled);
+        const CullingStats &culling_stats() const;
+
+        const FrameStats &frame_stats() const;
+        const LatencyStats &latency_stats() const;
+        // GPU time per scope ("frame", "main pass" and one per instance batch draw) and the
+        // main pass pipeline statistics, collected a frame late.
+        const GpuProfiler &gpu_profiler() const;
+        // The frame's passes and the barriers scheduled between them.
+        const RenderGraph &render_graph() const;
+        void reset_frame_stats();
+
     private:
         void create_instance();
         void create_debug_messenger();
         void create_surface(const Window &window);
         void create_physical_device();
         void create_logical_device();
-        void create_swapchain(const Window &window);
+        void create_allocator();
+        void create_pipeline_cache();
+        void create_swapchain(const Window &window, VkSwapchainKHR old_swapchain);
         void create_image_views();
         void create_render_pass();
+        void create_bindless_heap();
         void create_graphics_pipeline();
+        void swap_reloaded_pipelines();
+        void destroy_retired_pipelines(bool all);
         void create_framebuffers();
         void create_command_pool();
-        void create_command_buffer();
+        void create_command_buffers();
+        void create_worker_command_pools();
+        void create_profiler();
+        void create_render_graph();
         void create_sync_objects();
+        void create_render_finished_semaphores();
+        // Only with a present family separate from graphics.
+        void create_present_transfer();
+        // Acquires the image released by the render graph on the present queue, once
+        // `render_finished` is signaled, and signals `present_ready` for the present to wait on.
+        void submit_present_acquire(VkSemaphore render_finished, VkSemaphore present_ready);
+        // Replaces the swapchain and everything sized by it without waiting for the device.
+        // Returns false while the window has no area to present to.
+        bool recreate_swapchain();
+        void destroy_retired_swapchains(bool all);
+        void create_offscreen_images();
+        void create_readback_buffer();
+        void create_uploader();
+        void create_frame_allocator();
+        void write_frame_constants();
+        void create_async_compute();
+        void begin_compute_frame();
+        // Submits the frame's dispatches and returns the compute timeline value to wait for.
+        u64 submit_compute();
+        // Records the graphics side of this frame's compute buffer ownership transfers: the
+        // acquire before the first draw, or the release back after the last.
+        void transfer_compute_buffers(VkCommandBuffer command_buffer, bool acquire);
+        void destroy_compute_buffer(ComputeBuffer &buffer);
+        void destroy_compute_buffers();
+        void create_gpu_culling();
+        // Whether `batch` is drawn from its culled draw this frame.
+        bool culls(const InstanceBatch &batch) const;
+        // Records the culling of every batch in the draw list into the frame's compute work,
+        // which waits for the uploads up to `upload_value` first.
+        void record_culling(u64 upload_value);
+        // Copies the frame's visible count where `read_culling_results` finds it.
+        void record_culling_readback(VkCommandBuffer command_buffer);
+        // Collects the results of the slot's last frame, which must have completed.
+        void read_culling_results();
+        void create_default_mesh();
+        void destroy_meshes();
+        void destroy_instance_batch(InstanceBatch &batch);
+        void destroy_instance_batches();
+        bool create_shared_buffer(
+            VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer &buffer, Allocation &allocation
+        );
 
-        void record_command_buffer(uint32_t image_index);
+        void record_command_buffer(VkCommandBuffer command_buffer, uint32_t image_index);
+        void record_draws(VkCommandBuffer command_buffer, u32 first, u32 count) const;
+        VkCommandBuffer acquire_secondary_command_buffer(u32 worker);
+        void update_frame_stats();
+        void add_latency_sample(std::chrono::steady_clock::time_point frame_start);
 
         static bool are_validation_layers_supported();
-        static std::vector<const char *> get_required_instance_extensions();
-        bool is_device_suitable(VkPhysicalDevice device);
-        static bool check_device_extension_support(VkPhysicalDevice device);
+        static std::vector<const char *> get_required_instance_extensions(bool headless);
+        std::vector<const char *> get_required_device_extensions() const;
+        // Higher is better. Returns -1 and sets `reason` when the device cannot run the renderer.
+        i64 rate_device(VkPhysicalDevice device, std::string &reason);
+        static bool check_device_extension_support(
+            VkPhysicalDevice device, const std::vector<const char *> &extensions
+        );
 
         static VkExtent2D
         choose_extent(const VkSurfaceCapabilitiesKHR &capabilities, const Window &window);
 
-        VkShaderModule create_shader_module(const std::vector<char> &code);
-
         VkInstance instance;
         VkDebugUtilsMessengerEXT debug_messenger;
         VkPhysicalDevice physical_device;
         VkDevice device;
         VkQueue graphics_queue;
+        VkQueue transfer_queue;
+        // The graphics queue when the device has no separate compute family.
+        VkQueue compute_queue;
+        // The graphics queue unless no graphics family can present to the surface.
+        VkQueue present_queue;
+        u32 graphics_family;
+        u32 transfer_family;
+        u32 compute_family;
+        u32 present_family;
+        GpuAllocator allocator;
         VkSurfaceKHR surface;
+        const Window *window;
         VkSwapchainKHR swapchain;
+        // In headless mode these hold the offscreen render targets, one per frame in flight.
         std::vector<VkImage> swapchain_images;
         VkFormat swapchain_image_format;
         VkExtent2D swapchain_extent;
+        // Window size the swapchain was created for. The extent can differ from it permanently
+        // once the surface clamps it, so resizes are detected against this instead.
+        FramebufferSize swapchain_window_size;
         std::vector<VkImageView> swapchain_image_views;
         VkRenderPass render_pass;
+        BindlessHeap bindless;
         VkPipelineLayout pipeline_layout;
-        VkPipeline pipeline;
+        PipelineCache pipeline_cache;
+        PipelineRegistry pipelines;
+        // Where hot reload compiles shader.vert/.frag; TN_SHADER_DIR overrides it, in which
+        // case the pipelines are also built from the SPIR-V there instead of the embedded code.
+        std::string shader_directory;
+        ShaderManager shader_manager;
+        // Variants rebuilt by the shader watcher, waiting for the next frame boundary.
+        std::mutex reloaded_pipeline_mutex;
+        PipelineSet reloaded_pipelines;
+        std::deque<RetiredPipeline> retired_pipelines;
+        Uploader uploader;
+        FrameAllocator frame_allocator;
+        u32 frame_data_index;
+        // Element index of this frame's FrameConstants in the frame data buffer.
+        u32 frame_constants_index;
+        std::chrono::steady_clock::time_point start_time;
+        std::vector<Mesh> meshes;
+        std::vector<InstanceBatch> instance_batches;
+        AsyncCompute compute;
+        // Entries of destroyed buffers have no copies left and are reused.
+        std::vector<ComputeBuffer> compute_buffers;
+        bool gpu_culling;
+        u32 cull_pipeline;
+        // Compute buffer the culling dispatches count visible instances into, copied to one
+        // u32 per frame slot of the host visible readback.
+        u32 culling_counter;
+        VkBuffer culling_readback_buffer;
+        Allocation culling_readback_allocation;
+        // Instances culled by the last frame in each slot, 0 when it culled nothing.
+        std::vector<u32> culling_objects;
+        CullingStats culling;
+        bool draw_indirect_count_supported;
+        PFN_vkCmdDrawIndexedIndirectCountKHR cmd_draw_indexed_indirect_count;
+        // With VK_KHR_dynamic_rendering and VK_KHR_synchronization2 there is no render pass or
+        // framebuffer, so swapchain recreation only rebuilds image views.
+        bool dynamic_rendering_supported;
+        PFN_vkCmdBeginRenderingKHR cmd_begin_rendering;
+        PFN_vkCmdEndRenderingKHR cmd_end_rendering;
+        PFN_vkCmdPipelineBarrier2KHR cmd_pipeline_barrier2;
         std::vector<VkFramebuffer> framebuffers;
         VkCommandPool command_pool;
-        VkCommandBuffer command_buffer;
-        VkSemaphore image_available_semaphore;
-        VkSemaphore render_finished_semaphore;
-        VkFence in_flight_fence;
+        std::vector<VkCommandBuffer> command_buffers;
+        // Secondary command buffers are recorded in parallel from one pool per worker per frame
+        // in flight, indexed by frame * worker count + worker. Pools are reset as a whole once
+        // the frame has completed, and their buffers are reused in order.
+        JobSystem jobs;
+        std::vector<VkCommandPool> worker_command_pools;
+        std::vector<std::vector<VkCommandBuffer>> worker_command_buffers;
+        std::vector<u32> worker_command_buffers_used;
+        // Instance batches ready to draw this frame, gathered before recording fans out, and
+        // the profiler scope reserved for each.
+        std::vector<u32> draw_list;
+        std::vector<u32> draw_scopes;
+        // Compiled once; the target image and readback buffer are rebound every frame. The
+        // pass callbacks read the rest of the frame's state from the members after it.
+        RenderGraph graph;
+        GraphResource graph_target;
+        GraphResource graph_readback;
+        u32 graph_image_index;
+        u32 main_pass_scope;
+        std::vector<VkCommandBuffer> main_pass_secondaries;
+        GpuProfiler profiler;
+        bool pipeline_statistics_supported;
+        std::vector<VkSemaphore> image_available_semaphores;
+        QueueTimeline graphics_timeline;
+        // Graphics timeline value of the frame that last used each slot of the ring.
+        std::vector<u64> frame_values;
+        std::vector<VkSemaphore> render_finished_semaphores;
+        // With a separate present family, each frame's image is acquired by the present queue
+        // in a submission of its own, which signals the image's present ready semaphore.
+        QueueTimeline present_timeline;
+        std::vector<u64> present_values;
+        VkCommandPool present_command_pool;
+        std::vector<VkCommandBuffer> present_command_buffers;
+        std::vector<VkSemaphore> present_ready_semaphores;
+        std::deque<RetiredSwapchain> retired_swapchains;
+        u32 frames_in_flight;
+        u32 current_frame;
+        u64 submitted_frames;
+
+        PresentPolicy policy;
+        bool present_wait_supported;
+        PFN_vkWaitForPresentKHR wait_for_present;
+        // Present ids are `submitted_frames + 1` at submission. Waits for ids presented to an
+        // earlier swapchain are skipped, as the current one would never reach them.
+        u64 first_present_id;
+        std::chrono::steady_clock::duration frame_interval;
+        std::chrono::steady_clock::time_point next_frame_time;
+        bool frame_paced;
+        std::chrono::steady_clock::time_point paced_frame_start;
+        // When each frame slot last started, to measure latency once its frame completes.
+        std::vector<std::chrono::steady_clock::time_point> frame_start_times;
+
+        bool headless;
+        std::vector<Allocation> offscreen_image_allocations;
+        VkBuffer readback_buffer;
+        Allocation readback_allocation;
+        VkDeviceSize readback_slot_size;
 
+        FrameStats stats;
+        LatencyStats latency;
+        std::chrono::steady_clock::time_point last_frame_time;
+        bool has_last_frame_time;
     };
 } // namespace TANELORN_ENGINE_NAMESPACE
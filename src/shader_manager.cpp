@@ -0,0 +1,334 @@
+#include "shader_manager.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+#if defined(TN_PLATFORM_WIN32)
+#include <windows.h>
+#elif defined(TN_PLATFORM_XCB)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Generated by glslc -mfmt=c from shaders/ at build time.
+constexpr u32 embedded_vert_spirv[] =
+#include "shader.vert.inc"
+    ;
+constexpr u32 embedded_frag_spirv[] =
+#include "shader.frag.inc"
+    ;
+constexpr u32 embedded_particles_spirv[] =
+#include "particles.comp.inc"
+    ;
+constexpr u32 embedded_cull_spirv[] =
+#include "cull.comp.inc"
+    ;
+
+constexpr u32 spirv_magic = 0x07230203;
+// How often the watcher checks for shutdown, and on Windows for modified sources.
+constexpr int watch_interval_ms = 250;
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    SpirvCode::SpirvCode() : code{nullptr}, code_size{0}, mapping{nullptr} {}
+
+    SpirvCode::SpirvCode(const u32 *words, usize size)
+        : code{words}, code_size{size}, mapping{nullptr} {}
+
+    SpirvCode::~SpirvCode() {
+        this->unmap();
+    }
+
+    SpirvCode::SpirvCode(SpirvCode &&other)
+        : code{other.code}, code_size{other.code_size}, mapping{other.mapping} {
+        other.code = nullptr;
+        other.code_size = 0;
+        other.mapping = nullptr;
+    }
+
+    SpirvCode &SpirvCode::operator=(SpirvCode &&other) {
+        if (this != &other) {
+            this->unmap();
+            this->code = other.code;
+            this->code_size = other.code_size;
+            this->mapping = other.mapping;
+            other.code = nullptr;
+            other.code_size = 0;
+            other.mapping = nullptr;
+        }
+
+        return *this;
+    }
+
+    SpirvCode SpirvCode::map_file(const std::string &path) {
+        SpirvCode result;
+
+#if defined(TN_PLATFORM_WIN32)
+        HANDLE file = CreateFileA(
+            path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL, nullptr
+        );
+        if (file == INVALID_HANDLE_VALUE) {
+            std::cout << "Could not open the file: " << path << std::endl;
+            return result;
+        }
+
+        LARGE_INTEGER file_size{};
+        GetFileSizeEx(file, &file_size);
+        HANDLE file_mapping = file_size.QuadPart > 0
+                                  ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr)
+                                  : nullptr;
+        if (file_mapping) {
+            result.mapping = MapViewOfFile(file_mapping, FILE_MAP_READ, 0, 0, 0);
+            // The view keeps the file mapped after both handles are closed.
+            CloseHandle(file_mapping);
+        }
+        CloseHandle(file);
+        result.code_size = static_cast<usize>(file_size.QuadPart);
+#elif defined(TN_PLATFORM_XCB)
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            std::cout << "Could not open the file: " << path << std::endl;
+            return result;
+        }
+
+        struct stat file_stat{};
+        fstat(fd, &file_stat);
+        if (file_stat.st_size > 0) {
+            void *mapping = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            result.mapping = mapping != MAP_FAILED ? mapping : nullptr;
+        }
+        // The mapping stays valid after the descriptor is closed.
+        close(fd);
+        result.code_size = static_cast<usize>(file_stat.st_size);
+#endif
+
+        // Mappings are page aligned, so the words can be passed to Vulkan in place.
+        result.code = static_cast<const u32 *>(result.mapping);
+        if (!result.code || result.code_size % 4 != 0 || result.code[0] != spirv_magic) {
+            std::cout << "Not a SPIR-V binary: " << path << std::endl;
+            return SpirvCode();
+        }
+
+        return result;
+    }
+
+    const u32 *SpirvCode::words() const {
+        return this->code;
+    }
+
+    usize SpirvCode::size() const {
+        return this->code_size;
+    }
+
+    bool SpirvCode::empty() const {
+        return this->code_size == 0;
+    }
+
+    void SpirvCode::unmap() {
+        if (!this->mapping) {
+            return;
+        }
+
+#if defined(TN_PLATFORM_WIN32)
+        UnmapViewOfFile(this->mapping);
+#elif defined(TN_PLATFORM_XCB)
+        munmap(this->mapping, this->code_size);
+#endif
+        this->mapping = nullptr;
+    }
+
+    SpirvCode embedded_spirv(const std::string &name) {
+        if (name == "shader.vert") {
+            return SpirvCode(embedded_vert_spirv, sizeof(embedded_vert_spirv));
+        } else if (name == "shader.frag") {
+            return SpirvCode(embedded_frag_spirv, sizeof(embedded_frag_spirv));
+        } else if (name == "particles.comp") {
+            return SpirvCode(embedded_particles_spirv, sizeof(embedded_particles_spirv));
+        } else if (name == "cull.comp") {
+            return SpirvCode(embedded_cull_spirv, sizeof(embedded_cull_spirv));
+        }
+
+        return SpirvCode();
+    }
+
+    ShaderManager::ShaderManager() : stopping{false} {}
+
+    ShaderManager::~ShaderManager() {
+        this->destroy();
+    }
+
+    void ShaderManager::init(
+        const std::string &directory, const std::string &output_directory,
+        const std::vector<ShaderSource> &shaders, ReloadCallback on_reload
+    ) {
+        this->directory = directory;
+        this->output_directory = output_directory;
+        this->shaders = shaders;
+        this->compiled.assign(shaders.size(), false);
+        this->on_reload = std::move(on_reload);
+
+        std::error_code error;
+        std::filesystem::create_directories(output_directory, error);
+        if (error) {
+            std::cout << "Failed to create " << output_directory << ": " << error.message()
+                      << std::endl;
+        }
+
+        const char *compiler = getenv("TN_GLSLC");
+        this->compiler = compiler ? compiler : "glslc";
+
+        this->stopping = false;
+        this->thread = std::thread(&ShaderManager::watch_main, this);
+
+        std::cout << "Watching " << directory << " for shader changes." << std::endl;
+    }
+
+    void ShaderManager::destroy() {
+        if (!this->thread.joinable()) {
+            return;
+        }
+
+        this->stopping = true;
+        this->thread.join();
+
+        std::cout << "Destroyed shader manager.\n";
+    }
+
+#if defined(TN_PLATFORM_XCB)
+    void ShaderManager::watch_main() {
+        int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        u32 mask = IN_CLOSE_WRITE | IN_MOVED_TO;
+        if (fd < 0 || inotify_add_watch(fd, this->directory.c_str(), mask) < 0) {
+            std::cout << "Failed to watch " << this->directory << "; shader hot reload is off."
+                      << std::endl;
+            if (fd >= 0) {
+                close(fd);
+            }
+            return;
+        }
+
+        alignas(inotify_event) char buffer[4096];
+        while (!this->stopping) {
+            pollfd descriptor{fd, POLLIN, 0};
+            if (poll(&descriptor, 1, watch_interval_ms) <= 0) {
+                continue;
+            }
+
+            ssize_t length = read(fd, buffer, sizeof(buffer));
+            for (ssize_t offset = 0; offset < length;) {
+                const inotify_event *event =
+                    reinterpret_cast<const inotify_event *>(buffer + offset);
+                if (event->len > 0) {
+                    this->on_source_changed(event->name);
+                }
+                offset += sizeof(inotify_event) + event->len;
+            }
+        }
+
+        close(fd);
+    }
+#else
+    void ShaderManager::watch_main() {
+        std::vector<std::filesystem::file_time_type> write_times(this->shaders.size());
+        for (usize i = 0; i < this->shaders.size(); i++) {
+            std::error_code error;
+            write_times[i] = std::filesystem::last_write_time(
+                std::filesystem::path(this->directory) / this->shaders[i].source, error
+            );
+        }
+
+        while (!this->stopping) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(watch_interval_ms));
+
+            for (usize i = 0; i < this->shaders.size(); i++) {
+                std::error_code error;
+                std::filesystem::file_time_type write_time = std::filesystem::last_write_time(
+                    std::filesystem::path(this->directory) / this->shaders[i].source, error
+                );
+                if (!error && write_time != write_times[i]) {
+                    write_times[i] = write_time;
+                    this->on_source_changed(this->shaders[i].source);
+                }
+            }
+        }
+    }
+#endif
+
+    void ShaderManager::on_source_changed(const std::string &file_name) {
+        for (usize i = 0; i < this->shaders.size(); i++) {
+            if (this->shaders[i].source != file_name) {
+                continue;
+            }
+
+            if (!this->compile(this->shaders[i])) {
+                return;
+            }
+            this->compiled[i] = true;
+
+            // Stages that were not edited keep the code built into the binary; a stale file
+            // in the output directory could predate the source.
+            std::vector<SpirvCode> code;
+            for (usize j = 0; j < this->shaders.size(); j++) {
+                const ShaderSource &other = this->shaders[j];
+                if (this->compiled[j]) {
+                    code.push_back(SpirvCode::map_file(
+                        (std::filesystem::path(this->output_directory) / other.spirv).string()
+                    ));
+                } else {
+                    code.push_back(embedded_spirv(other.source));
+                }
+                if (code.back().empty()) {
+                    std::cout << "No SPIR-V for " << other.source << "; skipping the reload."
+                              << std::endl;
+                    return;
+                }
+            }
+
+            this->on_reload(code);
+            return;
+        }
+    }
+
+    bool ShaderManager::compile(const ShaderSource &shader) const {
+        std::filesystem::path source = std::filesystem::path(this->directory) / shader.source;
+        std::filesystem::path spirv =
+            std::filesystem::path(this->output_directory) / shader.spirv;
+
+        // Compile to a temporary file so a failed build never replaces a working binary.
+        std::filesystem::path output = spirv;
+        output += ".tmp";
+
+        std::string command = '"' + this->compiler + "\" \"" + source.string() + "\" -o \""
+                              + output.string() + '"';
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        int status = std::system(command.c_str());
+        f64 elapsed_ms =
+            std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start)
+                .count();
+
+        if (status != 0) {
+            std::cout << "Failed to compile " << source.string() << " (exit status " << status
+                      << "); keeping the previous pipeline." << std::endl;
+            return false;
+        }
+
+        std::error_code error;
+        std::filesystem::rename(output, spirv, error);
+        if (error) {
+            std::cout << "Failed to replace " << spirv.string() << ": " << error.message()
+                      << std::endl;
+            return false;
+        }
+
+        std::cout << "Compiled " << source.string() << " in " << elapsed_ms << " ms."
+                  << std::endl;
+        return true;
+    }
+} // namespace TANELORN_ENGINE_NAMESPACE
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "defines.h"
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    // SPIR-V words, either compiled into the binary or memory mapped from a file. Both are
+    // word aligned as VkShaderModuleCreateInfo::pCode requires, and neither is copied.
+    class SpirvCode {
+    public:
+        SpirvCode();
+        // Borrows `size` bytes of words that outlive the object, such as embedded shaders.
+        SpirvCode(const u32 *words, usize size);
+        ~SpirvCode();
+
+        SpirvCode(SpirvCode &&other);
+        SpirvCode &operator=(SpirvCode &&other);
+        SpirvCode(const SpirvCode &) = delete;
+        SpirvCode &operator=(const SpirvCode &) = delete;
+
+        // Maps a SPIR-V file. Returns empty code, after logging why, when the file is missing
+        // or does not hold SPIR-V.
+        static SpirvCode map_file(const std::string &path);
+
+        const u32 *words() const;
+        // In bytes, as VkShaderModuleCreateInfo::codeSize expects.
+        usize size() const;
+        bool empty() const;
+
+    private:
+        void unmap();
+
+        const u32 *code;
+        usize code_size;
+        // Non-null when the words are a file mapping this object owns.
+        void *mapping;
+    };
+
+    // The shaders compiled from shaders/ at build time, by source file name such as
+    // "shader.vert". Returns empty code for an unknown name.
+    SpirvCode embedded_spirv(const std::string &name);
+
+    // A GLSL source, relative to the source directory, and the SPIR-V file compiled from it,
+    // relative to the output directory.
+    struct ShaderSource {
+        std::string source;
+        std::string spirv;
+    };
+
+    // Watches a set of GLSL sources and recompiles them to SPIR-V on a background thread when
+    // one changes, using inotify on Linux and modification times elsewhere. After a successful
+    // compile the callback receives every shader's SPIR-V, in registration order, on that same
+    // background thread. Shaders not recompiled since `init` are passed as their embedded code.
+    class ShaderManager {
+    public:
+        using ReloadCallback = std::function<void(const std::vector<SpirvCode> &)>;
+
+        ShaderManager();
+        ~ShaderManager();
+
+        ShaderManager(const ShaderManager &) = delete;
+        ShaderManager &operator=(const ShaderManager &) = delete;
+
+        // The compiler is `glslc` from PATH unless TN_GLSLC names another. SPIR-V is written to
+        // `output_directory`, which is created if needed, so the sources stay untouched.
+        void init(
+            const std::string &directory, const std::string &output_directory,
+            const std::vector<ShaderSource> &shaders, ReloadCallback on_reload
+        );
+        void destroy();
+
+    private:
+        void watch_main();
+        void on_source_changed(const std::string &file_name);
+        bool compile(const ShaderSource &shader) const;
+
+        std::string directory;
+        std::string output_directory;
+        // Whether each shader has been compiled into the output directory since `init`.
+        std::vector<bool> compiled;
+        std::vector<ShaderSource> shaders;
+        ReloadCallback on_reload;
+        std::string compiler;
+        std::thread thread;
+        std::atomic<bool> stopping;
+    };
+} // namespace TANELORN_ENGINE_NAMESPACE
@@ -0,0 +1,184 @@
+#include "timeline.h"
+
+#include <iostream>
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    QueueTimeline::QueueTimeline()
+        : device{VK_NULL_HANDLE}, submit_queue{VK_NULL_HANDLE}, timeline{VK_NULL_HANDLE},
+          wait_for_values{nullptr}, get_counter_value{nullptr}, submitted_value{0},
+          completed_value{0} {}
+
+    QueueTimeline::~QueueTimeline() {
+        this->destroy();
+    }
+
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR QueueTimeline::required_features() {
+        VkPhysicalDeviceTimelineSemaphoreFeaturesKHR features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+        features.timelineSemaphore = VK_TRUE;
+        return features;
+    }
+
+    bool QueueTimeline::is_supported(VkPhysicalDevice physical_device) {
+        VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline{};
+        timeline.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &timeline;
+        vkGetPhysicalDeviceFeatures2(physical_device, &features);
+
+        return timeline.timelineSemaphore;
+    }
+
+    void QueueTimeline::init(VkDevice device, VkQueue queue) {
+        this->device = device;
+        this->submit_queue = queue;
+        this->submitted_value = 0;
+        this->completed_value = 0;
+
+        this->wait_for_values = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(
+            vkGetDeviceProcAddr(this->device, "vkWaitSemaphoresKHR")
+        );
+        this->get_counter_value = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
+            vkGetDeviceProcAddr(this->device, "vkGetSemaphoreCounterValueKHR")
+        );
+
+        VkSemaphoreTypeCreateInfoKHR type_info{};
+        type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+        type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+        type_info.initialValue = 0;
+
+        VkSemaphoreCreateInfo create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        create_info.pNext = &type_info;
+
+        VkResult res = vkCreateSemaphore(this->device, &create_info, nullptr, &this->timeline);
+        if (res == VK_SUCCESS) {
+            std::cout << "Successfully created timeline semaphore." << std::endl;
+        } else {
+            std::cout << "Failed to create timeline semaphore: " << res << std::endl;
+        }
+    }
+
+    void QueueTimeline::destroy() {
+        if (this->device == VK_NULL_HANDLE) {
+            return;
+        }
+
+        vkDestroySemaphore(this->device, this->timeline, nullptr);
+        this->timeline = VK_NULL_HANDLE;
+        this->device = VK_NULL_HANDLE;
+
+        std::cout << "Destroyed timeline semaphore.\n";
+    }
+
+    void QueueTimeline::add_command_buffer(VkCommandBuffer command_buffer) {
+        this->command_buffers.push_back(command_buffer);
+    }
+
+    void QueueTimeline::add_wait(QueueTimeline &timeline, u64 value, VkPipelineStageFlags stages) {
+        if (timeline.is_complete(value)) {
+            return;
+        }
+
+        this->wait_semaphores.push_back(timeline.semaphore());
+        this->wait_values.push_back(value);
+        this->wait_stages.push_back(stages);
+    }
+
+    void QueueTimeline::add_wait(VkSemaphore semaphore, VkPipelineStageFlags stages) {
+        this->wait_semaphores.push_back(semaphore);
+        this->wait_values.push_back(0);
+        this->wait_stages.push_back(stages);
+    }
+
+    void QueueTimeline::add_signal(VkSemaphore semaphore) {
+        this->signal_semaphores.push_back(semaphore);
+        this->signal_values.push_back(0);
+    }
+
+    u64 QueueTimeline::submit() {
+        u64 value = this->submitted_value + 1;
+        this->signal_semaphores.push_back(this->timeline);
+        this->signal_values.push_back(value);
+
+        VkTimelineSemaphoreSubmitInfoKHR timeline_info{};
+        timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+        timeline_info.waitSemaphoreValueCount = static_cast<u32>(this->wait_values.size());
+        timeline_info.pWaitSemaphoreValues = this->wait_values.data();
+        timeline_info.signalSemaphoreValueCount = static_cast<u32>(this->signal_values.size());
+        timeline_info.pSignalSemaphoreValues = this->signal_values.data();
+
+        VkSubmitInfo submit_info{};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.pNext = &timeline_info;
+        submit_info.waitSemaphoreCount = static_cast<u32>(this->wait_semaphores.size());
+        submit_info.pWaitSemaphores = this->wait_semaphores.data();
+        submit_info.pWaitDstStageMask = this->wait_stages.data();
+        submit_info.commandBufferCount = static_cast<u32>(this->command_buffers.size());
+        submit_info.pCommandBuffers = this->command_buffers.data();
+        submit_info.signalSemaphoreCount = static_cast<u32>(this->signal_semaphores.size());
+        submit_info.pSignalSemaphores = this->signal_semaphores.data();
+
+        VkResult res = vkQueueSubmit(this->submit_queue, 1, &submit_info, VK_NULL_HANDLE);
+        if (res == VK_SUCCESS) {
+            this->submitted_value = value;
+        } else {
+            std::cout << "Failed to submit: " << res << std::endl;
+        }
+
+        this->command_buffers.clear();
+        this->wait_semaphores.clear();
+        this->wait_values.clear();
+        this->wait_stages.clear();
+        this->signal_semaphores.clear();
+        this->signal_values.clear();
+
+        return this->submitted_value;
+    }
+
+    u64 QueueTimeline::next_value() const {
+        return this->submitted_value + 1;
+    }
+
+    u64 QueueTimeline::last_submitted() const {
+        return this->submitted_value;
+    }
+
+    bool QueueTimeline::is_complete(u64 value) {
+        if (value <= this->completed_value) {
+            return true;
+        }
+
+        this->get_counter_value(this->device, this->timeline, &this->completed_value);
+        return value <= this->completed_value;
+    }
+
+    bool QueueTimeline::wait(u64 value, u64 timeout_ns) {
+        if (value <= this->completed_value) {
+            return true;
+        }
+
+        VkSemaphoreWaitInfoKHR wait_info{};
+        wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+        wait_info.semaphoreCount = 1;
+        wait_info.pSemaphores = &this->timeline;
+        wait_info.pValues = &value;
+
+        if (this->wait_for_values(this->device, &wait_info, timeout_ns) != VK_SUCCESS) {
+            return false;
+        }
+
+        this->completed_value = value;
+        return true;
+    }
+
+    VkSemaphore QueueTimeline::semaphore() const {
+        return this->timeline;
+    }
+
+    VkQueue QueueTimeline::queue() const {
+        return this->submit_queue;
+    }
+} // namespace TANELORN_ENGINE_NAMESPACE
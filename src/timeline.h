@@ -0,0 +1,70 @@
+#pragma once
+
+#include "defines.h"
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    // A queue and the timeline semaphore (VK_KHR_timeline_semaphore) its submissions signal.
+    // Every `submit` signals the next value, so value N is reached once the Nth submission has
+    // completed. CPU waits, waits from other queues and resource retirement are all expressed as
+    // "value >= N" instead of a fence or semaphore per submission.
+    //
+    // Work is gathered with `add_*` and goes out in a single vkQueueSubmit on `submit`, so a
+    // frame's command buffers and dependencies cost one submission per queue. Several timelines
+    // may share one VkQueue; they must then be submitted from the same thread.
+    class QueueTimeline {
+    public:
+        QueueTimeline();
+        ~QueueTimeline();
+
+        QueueTimeline(const QueueTimeline &) = delete;
+        QueueTimeline &operator=(const QueueTimeline &) = delete;
+
+        static VkPhysicalDeviceTimelineSemaphoreFeaturesKHR required_features();
+        static bool is_supported(VkPhysicalDevice physical_device);
+
+        void init(VkDevice device, VkQueue queue);
+        void destroy();
+
+        void add_command_buffer(VkCommandBuffer command_buffer);
+        // Waits at `stages` until `timeline` reaches `value`. Values already reached are skipped.
+        void add_wait(QueueTimeline &timeline, u64 value, VkPipelineStageFlags stages);
+        // Binary semaphores, for swapchain acquire and present.
+        void add_wait(VkSemaphore semaphore, VkPipelineStageFlags stages);
+        void add_signal(VkSemaphore semaphore);
+        // Submits everything added since the last call and returns the value it signals.
+        u64 submit();
+
+        // Value the next `submit` will signal.
+        u64 next_value() const;
+        u64 last_submitted() const;
+        // Non-blocking.
+        bool is_complete(u64 value);
+        // Returns false if `timeout_ns` elapsed first.
+        bool wait(u64 value, u64 timeout_ns = UINT64_MAX);
+
+        VkSemaphore semaphore() const;
+        VkQueue queue() const;
+
+    private:
+        VkDevice device;
+        VkQueue submit_queue;
+        VkSemaphore timeline;
+        PFN_vkWaitSemaphoresKHR wait_for_values;
+        PFN_vkGetSemaphoreCounterValueKHR get_counter_value;
+        u64 submitted_value;
+        // Last value observed on the semaphore, so completed values need no query.
+        u64 completed_value;
+
+        std::vector<VkCommandBuffer> command_buffers;
+        std::vector<VkSemaphore> wait_semaphores;
+        // 0 for binary semaphores; ignored by the driver.
+        std::vector<u64> wait_values;
+        std::vector<VkPipelineStageFlags> wait_stages;
+        std::vector<VkSemaphore> signal_semaphores;
+        std::vector<u64> signal_values;
+    };
+} // namespace TANELORN_ENGINE_NAMESPACE
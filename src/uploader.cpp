@@ -0,0 +1,239 @@
+#include "uploader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+constexpr u32 upload_batch_count = 8;
+constexpr VkDeviceSize upload_copy_alignment = 16;
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    Uploader::Uploader()
+        : device{VK_NULL_HANDLE}, allocator{nullptr}, family{0}, command_pool{VK_NULL_HANDLE},
+          ring_buffer{VK_NULL_HANDLE}, ring_allocation{}, ring_size{0}, ring_head{0},
+          ring_used{0}, current{0}, completed_id{0}, upload_stats{} {}
+
+    Uploader::~Uploader() {
+        this->destroy();
+    }
+
+    void Uploader::init(
+        VkDevice device, GpuAllocator &allocator, u32 queue_family, VkQueue queue,
+        VkDeviceSize ring_size
+    ) {
+        this->device = device;
+        this->allocator = &allocator;
+        this->family = queue_family;
+        this->ring_size = ring_size;
+        this->transfer_timeline.init(device, queue);
+
+        VkCommandPoolCreateInfo pool_info{};
+        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT
+                          | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        pool_info.queueFamilyIndex = queue_family;
+        vkCreateCommandPool(this->device, &pool_info, nullptr, &this->command_pool);
+
+        this->batches.resize(upload_batch_count);
+        for (Batch &batch : this->batches) {
+            VkCommandBufferAllocateInfo alloc_info{};
+            alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            alloc_info.commandPool = this->command_pool;
+            alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            alloc_info.commandBufferCount = 1;
+            vkAllocateCommandBuffers(this->device, &alloc_info, &batch.command_buffer);
+
+            batch.id = 0;
+            batch.ring_bytes = 0;
+            batch.recording = false;
+            batch.in_flight = false;
+        }
+
+        VkBufferCreateInfo ring_info{};
+        ring_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        ring_info.size = ring_size;
+        ring_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        ring_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (this->allocator->create_buffer(
+                ring_info,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                this->ring_buffer, this->ring_allocation
+            )) {
+            std::cout << "Successfully created uploader on queue family " << queue_family << '.'
+                      << std::endl;
+        }
+    }
+
+    void Uploader::destroy() {
+        if (this->device == VK_NULL_HANDLE) {
+            return;
+        }
+
+        vkQueueWaitIdle(this->transfer_timeline.queue());
+        this->transfer_timeline.destroy();
+        this->batches.clear();
+        this->in_flight.clear();
+        vkDestroyCommandPool(this->device, this->command_pool, nullptr);
+        this->allocator->destroy_buffer(this->ring_buffer, this->ring_allocation);
+        this->device = VK_NULL_HANDLE;
+
+        std::cout << "Destroyed uploader.\n";
+    }
+
+    u64 Uploader::upload_buffer(
+        VkBuffer dst, VkDeviceSize dst_offset, const void *data, VkDeviceSize size
+    ) {
+        // Split large copies so a single upload can stream through a ring smaller than itself.
+        VkDeviceSize max_chunk = this->ring_size / 4;
+        const u8 *src = static_cast<const u8 *>(data);
+
+        while (size > 0) {
+            VkDeviceSize chunk = std::min(size, max_chunk);
+            VkDeviceSize ring_offset = this->reserve(chunk, upload_copy_alignment);
+            memcpy(static_cast<u8 *>(this->ring_allocation.mapped) + ring_offset, src, chunk);
+
+            VkBufferCopy region{};
+            region.srcOffset = ring_offset;
+            region.dstOffset = dst_offset;
+            region.size = chunk;
+            vkCmdCopyBuffer(
+                this->current_batch().command_buffer, this->ring_buffer, dst, 1, &region
+            );
+
+            this->upload_stats.bytes_uploaded += chunk;
+            src += chunk;
+            dst_offset += chunk;
+            size -= chunk;
+        }
+
+        return this->current_batch().id;
+    }
+
+    void Uploader::flush() {
+        Batch &batch = this->batches[this->current];
+        if (!batch.recording) {
+            return;
+        }
+
+        vkEndCommandBuffer(batch.command_buffer);
+
+        this->transfer_timeline.add_command_buffer(batch.command_buffer);
+        this->transfer_timeline.submit();
+
+        batch.recording = false;
+        batch.in_flight = true;
+        batch.submit_time = std::chrono::steady_clock::now();
+        this->in_flight.push_back(this->current);
+        this->current = (this->current + 1) % upload_batch_count;
+    }
+
+    bool Uploader::is_submitted(u64 id) const {
+        return id <= this->transfer_timeline.last_submitted();
+    }
+
+    void Uploader::poll() {
+        this->retire(false);
+    }
+
+    bool Uploader::is_complete(u64 id) {
+        this->retire(false);
+        return id <= this->completed_id;
+    }
+
+    void Uploader::wait(u64 id) {
+        const Batch &batch = this->batches[this->current];
+        if (batch.recording && batch.id <= id) {
+            this->flush();
+        }
+        while (id > this->completed_id && !this->in_flight.empty()) {
+            this->retire(true);
+        }
+    }
+
+    u32 Uploader::queue_family() const {
+        return this->family;
+    }
+
+    QueueTimeline &Uploader::timeline() {
+        return this->transfer_timeline;
+    }
+
+    const UploadStats &Uploader::stats() const {
+        return this->upload_stats;
+    }
+
+    VkDeviceSize Uploader::reserve(VkDeviceSize size, VkDeviceSize alignment) {
+        for (;;) {
+            VkDeviceSize offset = (this->ring_head + alignment - 1) / alignment * alignment;
+            VkDeviceSize padding = offset - this->ring_head;
+            if (offset + size > this->ring_size) {
+                // Skip the tail end of the ring and start again from zero.
+                offset = 0;
+                padding = this->ring_size - this->ring_head;
+            }
+
+            if (this->ring_used + padding + size <= this->ring_size) {
+                Batch &batch = this->current_batch();
+                batch.ring_bytes += padding + size;
+                this->ring_used += padding + size;
+                this->ring_head = offset + size;
+                return offset;
+            }
+
+            // Out of staging space: submit what we have and wait for the oldest batch.
+            this->flush();
+            this->retire(true);
+        }
+    }
+
+    Uploader::Batch &Uploader::current_batch() {
+        Batch &batch = this->batches[this->current];
+
+        if (!batch.recording) {
+            while (batch.in_flight) {
+                this->retire(true);
+            }
+
+            vkResetCommandBuffer(batch.command_buffer, 0);
+
+            VkCommandBufferBeginInfo begin_info{};
+            begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            vkBeginCommandBuffer(batch.command_buffer, &begin_info);
+
+            // Only one batch records at a time, so it is the next one submitted.
+            batch.id = this->transfer_timeline.next_value();
+            batch.ring_bytes = 0;
+            batch.recording = true;
+        }
+
+        return batch;
+    }
+
+    void Uploader::retire(bool block) {
+        while (!this->in_flight.empty()) {
+            Batch &batch = this->batches[this->in_flight.front()];
+
+            if (block) {
+                this->transfer_timeline.wait(batch.id);
+                block = false;
+            } else if (!this->transfer_timeline.is_complete(batch.id)) {
+                return;
+            }
+
+            std::chrono::steady_clock::duration latency =
+                std::chrono::steady_clock::now() - batch.submit_time;
+            f64 latency_ms = std::chrono::duration<f64, std::milli>(latency).count();
+            this->upload_stats.total_latency_ms += latency_ms;
+            this->upload_stats.max_latency_ms =
+                std::max(this->upload_stats.max_latency_ms, latency_ms);
+            this->upload_stats.batches_completed++;
+
+            this->ring_used -= batch.ring_bytes;
+            this->completed_id = batch.id;
+            batch.in_flight = false;
+            this->in_flight.pop_front();
+        }
+    }
+} // namespace TANELORN_ENGINE_NAMESPACE
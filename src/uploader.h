@@ -0,0 +1,110 @@
+#pragma once
+
+#include "allocator.h"
+#include "defines.h"
+#include "timeline.h"
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <deque>
+#include <vector>
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    struct UploadStats {
+        u64 bytes_uploaded;
+        u64 batches_completed;
+        // Time from vkQueueSubmit until the batch was observed complete on the timeline.
+        f64 total_latency_ms;
+        f64 max_latency_ms;
+
+        f64 average_latency_ms() const {
+            return this->batches_completed > 0 ? this->total_latency_ms / this->batches_completed
+                                               : 0.0;
+        }
+
+        f64 bandwidth_mb_per_s() const {
+            return this->total_latency_ms > 0.0
+                       ? (this->bytes_uploaded / (1024.0 * 1024.0))
+                             / (this->total_latency_ms / 1000.0)
+                       : 0.0;
+        }
+    };
+
+    // Streams data into device-local buffers through a persistently mapped staging ring. Copies
+    // are recorded into batches and submitted on the transfer queue, so large uploads never wait
+    // on rendering and rendering only waits on an upload when it actually needs the data. Batch
+    // ids are values of the transfer queue's timeline, which other queues can wait on directly.
+    class Uploader {
+    public:
+        static constexpr VkDeviceSize DEFAULT_RING_SIZE = 64ull * 1024 * 1024;
+
+        Uploader();
+        ~Uploader();
+
+        Uploader(const Uploader &) = delete;
+        Uploader &operator=(const Uploader &) = delete;
+
+        void init(
+            VkDevice device, GpuAllocator &allocator, u32 queue_family, VkQueue queue,
+            VkDeviceSize ring_size = DEFAULT_RING_SIZE
+        );
+        void destroy();
+
+        // Copies `size` bytes into `dst` at `dst_offset`. Returns the id of the batch that
+        // completes the copy; pass it to `is_complete`. The copy is submitted by the next
+        // `flush`, so uploads made within a frame share one submission.
+        u64
+        upload_buffer(VkBuffer dst, VkDeviceSize dst_offset, const void *data, VkDeviceSize size);
+        // Submits everything recorded so far.
+        void flush();
+        // Non-blocking. Retires finished batches and reports whether batch `id` has completed.
+        bool is_complete(u64 id);
+        void wait(u64 id);
+
+        // True once batch `id` has been submitted, so other queues may wait on it.
+        bool is_submitted(u64 id) const;
+        // Non-blocking. Retires every batch that has completed. Call once per frame: a batch's
+        // latency is taken when it is first seen complete, so it is only as fine as the polling.
+        void poll();
+
+        u32 queue_family() const;
+        QueueTimeline &timeline();
+        const UploadStats &stats() const;
+
+    private:
+        struct Batch {
+            VkCommandBuffer command_buffer;
+            // Timeline value the batch signals.
+            u64 id;
+            VkDeviceSize ring_bytes;
+            bool recording;
+            bool in_flight;
+            std::chrono::steady_clock::time_point submit_time;
+        };
+
+        VkDeviceSize reserve(VkDeviceSize size, VkDeviceSize alignment);
+        Batch &current_batch();
+        void retire(bool block);
+
+        VkDevice device;
+        GpuAllocator *allocator;
+        u32 family;
+        QueueTimeline transfer_timeline;
+        VkCommandPool command_pool;
+
+        VkBuffer ring_buffer;
+        Allocation ring_allocation;
+        VkDeviceSize ring_size;
+        VkDeviceSize ring_head;
+        VkDeviceSize ring_used;
+
+        std::vector<Batch> batches;
+        // Submitted batches in submission order; they complete and free ring space in order.
+        std::deque<u32> in_flight;
+        u32 current;
+        u64 completed_id;
+
+        UploadStats upload_stats;
+    };
+} // namespace TANELORN_ENGINE_NAMESPACE
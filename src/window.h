@@ -2,7 +2,11 @@
 
 #include "defines.h"
 
+#if defined(TN_PLATFORM_WIN32)
 #include <windows.h>
+#elif defined(TN_PLATFORM_XCB)
+#include <xcb/xcb.h>
+#endif
 
 namespace TANELORN_ENGINE_NAMESPACE {
     struct FramebufferSize {
@@ -19,17 +23,34 @@ namespace TANELORN_ENGINE_NAMESPACE {
         Window &operator=(const Window &) = delete;
 
         bool close_requested();
+        // Drains every pending event so input never lags behind by more than one frame.
         void poll_events();
         FramebufferSize framebuffer_size() const;
+
+#if defined(TN_PLATFORM_WIN32)
         HWND get_raw_handle() const;
         HINSTANCE get_instance() const;
+#elif defined(TN_PLATFORM_XCB)
+        xcb_window_t get_raw_handle() const;
+        xcb_connection_t *get_connection() const;
+#endif
 
     private:
+        bool running;
+
+#if defined(TN_PLATFORM_WIN32)
         HWND wnd;
         HINSTANCE instance;
-        bool running;
 
         static LRESULT CALLBACK
         main_window_proc(HWND window, UINT message, WPARAM w_param, LPARAM l_param);
+#elif defined(TN_PLATFORM_XCB)
+        xcb_connection_t *connection;
+        xcb_window_t wnd;
+        xcb_atom_t wm_delete_window;
+        FramebufferSize size;
+
+        void handle_event(const xcb_generic_event_t *event);
+#endif
     };
 } // namespace TANELORN_ENGINE_NAMESPACE
@@ -1,9 +1,10 @@
 #include "window.h"
+#include "cpu_profiler.h"
 
 #include <iostream>
 
 namespace TANELORN_ENGINE_NAMESPACE {
-    Window::Window() : instance{GetModuleHandle(nullptr)}, running{false} {
+    Window::Window() : running{false}, instance{GetModuleHandle(nullptr)} {
         WNDCLASSA wc{};
         wc.style = CS_HREDRAW | CS_VREDRAW | CS_OWNDC;
         wc.lpfnWndProc = main_window_proc;
@@ -27,15 +28,13 @@ namespace TANELORN_ENGINE_NAMESPACE {
         client_rect.right = 800;
         client_rect.bottom = 600;
 
-        if (!AdjustWindowRect(
-                &client_rect, (WS_OVERLAPPEDWINDOW | WS_VISIBLE) ^ WS_THICKFRAME, 0
-            )) {
+        if (!AdjustWindowRect(&client_rect, WS_OVERLAPPEDWINDOW | WS_VISIBLE, 0)) {
             DWORD err = GetLastError();
             std::cout << "Failed to adjust client rect: " << err << std::endl;
         }
 
         this->wnd = CreateWindowExA(
-            0, "tnWindowClass", "Vulkan", (WS_OVERLAPPEDWINDOW | WS_VISIBLE) ^ WS_THICKFRAME,
+            0, "tnWindowClass", "Vulkan", WS_OVERLAPPEDWINDOW | WS_VISIBLE,
             CW_USEDEFAULT, CW_USEDEFAULT, client_rect.right - client_rect.left,
             client_rect.bottom - client_rect.top, nullptr, nullptr, this->instance,
             static_cast<LPVOID>(this)
@@ -61,9 +60,11 @@ namespace TANELORN_ENGINE_NAMESPACE {
     }
 
     void Window::poll_events() {
+        TN_PROFILE_SCOPE("Window::poll_events");
+
         MSG msg{};
 
-        if (PeekMessageA(&msg, nullptr, 0, 0, PM_REMOVE) > 0) {
+        while (PeekMessageA(&msg, nullptr, 0, 0, PM_REMOVE) > 0) {
             TranslateMessage(&msg);
             DispatchMessageA(&msg);
         }
@@ -0,0 +1,148 @@
+#include "window.h"
+#include "cpu_profiler.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// X11 keycode of the escape key on evdev based servers (Xorg and XWayland).
+constexpr xcb_keycode_t escape_keycode = 9;
+
+static xcb_atom_t intern_atom(xcb_connection_t *connection, const char *name) {
+    xcb_intern_atom_cookie_t cookie =
+        xcb_intern_atom(connection, 0, static_cast<uint16_t>(strlen(name)), name);
+    xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(connection, cookie, nullptr);
+
+    xcb_atom_t atom = XCB_ATOM_NONE;
+    if (reply) {
+        atom = reply->atom;
+        free(reply);
+    }
+
+    return atom;
+}
+
+namespace TANELORN_ENGINE_NAMESPACE {
+    Window::Window()
+        : running{false}, connection{nullptr}, wnd{0}, wm_delete_window{XCB_ATOM_NONE},
+          size{800, 600} {
+        int screen_index = 0;
+        this->connection = xcb_connect(nullptr, &screen_index);
+
+        if (xcb_connection_has_error(this->connection)) {
+            std::cout << "Failed to connect to the X server." << std::endl;
+            return;
+        }
+
+        const xcb_setup_t *setup = xcb_get_setup(this->connection);
+        xcb_screen_iterator_t it = xcb_setup_roots_iterator(setup);
+        for (int i = 0; i < screen_index; i++) {
+            xcb_screen_next(&it);
+        }
+        xcb_screen_t *screen = it.data;
+
+        this->wnd = xcb_generate_id(this->connection);
+
+        uint32_t value_mask = XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK;
+        uint32_t values[2] = {
+            screen->black_pixel,
+            XCB_EVENT_MASK_KEY_PRESS | XCB_EVENT_MASK_STRUCTURE_NOTIFY};
+
+        xcb_create_window(
+            this->connection, XCB_COPY_FROM_PARENT, this->wnd, screen->root, 0, 0,
+            static_cast<uint16_t>(this->size.width), static_cast<uint16_t>(this->size.height), 0,
+            XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual, value_mask, values
+        );
+
+        const char *title = "Vulkan";
+        xcb_change_property(
+            this->connection, XCB_PROP_MODE_REPLACE, this->wnd, XCB_ATOM_WM_NAME, XCB_ATOM_STRING,
+            8, static_cast<uint32_t>(strlen(title)), title
+        );
+
+        // Ask the window manager to send a client message instead of killing the connection
+        // when the user closes the window.
+        xcb_atom_t wm_protocols = intern_atom(this->connection, "WM_PROTOCOLS");
+        this->wm_delete_window = intern_atom(this->connection, "WM_DELETE_WINDOW");
+        xcb_change_property(
+            this->connection, XCB_PROP_MODE_REPLACE, this->wnd, wm_protocols, XCB_ATOM_ATOM, 32, 1,
+            &this->wm_delete_window
+        );
+
+        xcb_map_window(this->connection, this->wnd);
+        xcb_flush(this->connection);
+
+        std::cout << "Successfully created window." << std::endl;
+        this->running = true;
+    }
+
+    Window::~Window() {
+        if (this->connection) {
+            if (this->wnd) {
+                xcb_destroy_window(this->connection, this->wnd);
+            }
+            xcb_disconnect(this->connection);
+        }
+        std::cout << "Destroyed window." << std::endl;
+    }
+
+    bool Window::close_requested() {
+        return !this->running;
+    }
+
+    void Window::poll_events() {
+        TN_PROFILE_SCOPE("Window::poll_events");
+
+        xcb_generic_event_t *event;
+
+        while ((event = xcb_poll_for_event(this->connection))) {
+            this->handle_event(event);
+            free(event);
+        }
+
+        if (xcb_connection_has_error(this->connection)) {
+            this->running = false;
+        }
+    }
+
+    FramebufferSize Window::framebuffer_size() const {
+        return this->size;
+    }
+
+    xcb_window_t Window::get_raw_handle() const {
+        return this->wnd;
+    }
+
+    xcb_connection_t *Window::get_connection() const {
+        return this->connection;
+    }
+
+    void Window::handle_event(const xcb_generic_event_t *event) {
+        switch (event->response_type & ~0x80) {
+            case XCB_CLIENT_MESSAGE: {
+                const xcb_client_message_event_t *message =
+                    reinterpret_cast<const xcb_client_message_event_t *>(event);
+                if (message->data.data32[0] == this->wm_delete_window) {
+                    this->running = false;
+                }
+            } break;
+            case XCB_DESTROY_NOTIFY: {
+                this->running = false;
+            } break;
+            case XCB_KEY_PRESS: {
+                const xcb_key_press_event_t *key =
+                    reinterpret_cast<const xcb_key_press_event_t *>(event);
+                if (key->detail == escape_keycode) {
+                    this->running = false;
+                }
+            } break;
+            case XCB_CONFIGURE_NOTIFY: {
+                const xcb_configure_notify_event_t *configure =
+                    reinterpret_cast<const xcb_configure_notify_event_t *>(event);
+                this->size = FramebufferSize{configure->width, configure->height};
+            } break;
+            default:
+                break;
+        }
+    }
+} // namespace TANELORN_ENGINE_NAMESPACE